@@ -7,6 +7,10 @@
 #include <algorithm>  // std::max_element
 #include <functional> // std::bind std::placeholders
 #include "lariat.h"
+#include "lariat_queue.h"
+#include "lariat_file.h"
+#include "lariat_trace.h"
+#include "lariat_indirect.h"
 #include <algorithm>
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -275,7 +279,7 @@ void test16() // compact and use find
     std::cout << "After compacting" << std::endl;
     std::cout << lar << std::endl;
     for( int i = -1; i <= 19; ++i ) {
-        unsigned pos = lar.find( i+1 );
+        size_t pos = lar.find( i+1 );
         std::cout << "find " << i+1;
         if ( pos == lar.size() ) {
             std::cout << ":   not found " << std::endl;
@@ -873,9 +877,9 @@ void run_scenario_cmp_to_vector // for correctess
                 break;
             case Find:
                 //std::cout << "Find " << std::endl;
-                int find_pos                        = lar.find( val );
+                size_t find_pos                     = lar.find( val );
                 std::vector<int>::iterator find_it  = std::find( v.begin(), v.end(), val );
-                if ( ( find_pos == -1 && find_it == v.end() )|| ( find_pos == static_cast<int>( find_it-v.begin() ) ) ) {}
+                if ( ( find_pos == static_cast<size_t>( -1 ) && find_it == v.end() )|| ( find_pos == static_cast<size_t>( find_it-v.begin() ) ) ) {}
                 else {
                     std::cout << "Find failed for value " << val << std::endl;
                 }
@@ -907,6 +911,87 @@ void run_scenario_cmp_to_vector // for correctess
 }
 
 #include <chrono>
+// HDR-style latency histogram: exact below 16ns, above that each power of two
+// is split into 16 linear buckets, so any recorded value is off by < 6.25%
+class LatencyHistogram {
+    public:
+        LatencyHistogram() : counts( 64 << sub_bits ), total( 0 ), max( 0 ) {}
+
+        void Record( unsigned long long ns )
+        {
+            ++counts[ Bucket( ns ) ];
+            ++total;
+            if ( ns > max ) {
+                max = ns;
+            }
+        }
+
+        unsigned long long Count() const { return total; }
+        unsigned long long Max() const   { return max; }
+
+        // upper edge of the bucket holding the p-th percentile (0 < p <= 100)
+        unsigned long long Percentile( double p ) const
+        {
+            unsigned long long rank = static_cast<unsigned long long>( p / 100.0 * static_cast<double>( total ) + 0.5 );
+            if ( rank < 1 ) {
+                rank = 1;
+            }
+            unsigned long long seen = 0;
+            for ( size_t b = 0; b < counts.size(); ++b ) {
+                seen += counts[b];
+                if ( seen >= rank ) {
+                    unsigned long long edge = UpperEdge( b );
+                    return edge < max ? edge : max;
+                }
+            }
+            return max;
+        }
+    private:
+        static const int sub_bits = 4;
+        std::vector<unsigned long long> counts;
+        unsigned long long total;
+        unsigned long long max;
+
+        static size_t Bucket( unsigned long long ns )
+        {
+            if ( ns < ( 1ull << sub_bits ) ) {
+                return static_cast<size_t>( ns );
+            }
+            int exponent = 63;
+            while ( !( ns >> exponent ) ) {
+                --exponent;
+            }
+            size_t sub = static_cast<size_t>( ( ns >> ( exponent - sub_bits ) ) & ( ( 1ull << sub_bits ) - 1 ) );
+            return ( static_cast<size_t>( exponent - sub_bits + 1 ) << sub_bits ) + sub;
+        }
+        static unsigned long long UpperEdge( size_t bucket )
+        {
+            if ( bucket < ( 1u << sub_bits ) ) {
+                return bucket;
+            }
+            int exponent = static_cast<int>( bucket >> sub_bits ) + sub_bits - 1;
+            unsigned long long sub = bucket & ( ( 1u << sub_bits ) - 1 );
+            unsigned long long width = 1ull << ( exponent - sub_bits );
+            return ( 1ull << exponent ) + ( sub + 1 ) * width - 1;
+        }
+};
+
+void DrawLatencies( std::map< Action, LatencyHistogram > const& histograms, std::map< Action, std::string > & labels )
+{
+    std::cout << "Latency (ns)" << std::endl;
+    std::cout << std::left << std::setw( 11 ) << "" << std::right
+              << std::setw( 9 ) << "count" << std::setw( 9 ) << "p50" << std::setw( 9 ) << "p90"
+              << std::setw( 9 ) << "p99" << std::setw( 11 ) << "max" << std::endl;
+    for ( auto const& el : histograms ) {
+        std::cout << std::left << std::setw( 11 ) << labels[ el.first ] << std::right
+                  << std::setw( 9 ) << el.second.Count()
+                  << std::setw( 9 ) << el.second.Percentile( 50 )
+                  << std::setw( 9 ) << el.second.Percentile( 90 )
+                  << std::setw( 9 ) << el.second.Percentile( 99 )
+                  << std::setw( 11 ) << el.second.Max() << std::endl;
+    }
+}
+
 template < int nodesize >
 void run_scenario_cmp_to_vector_time // optimizations
 (
@@ -916,17 +1001,23 @@ void run_scenario_cmp_to_vector_time // optimizations
     float popbackF, float popfrontF,    // normalized by hand
     float compactF,
     float indexF,
-    float findF
+    float findF,
+    bool  timeEach = false              // latency histogram, its clock reads count in the total
 )
 {
     LariatScenario sc( num_operations, 200000, insertF, eraseF, pushbackF, pushfrontF, popbackF, popfrontF, compactF, indexF, findF);
 
+    std::map< Action, LatencyHistogram > latencies;
     std::chrono::time_point<std::chrono::system_clock> start = std::chrono::system_clock::now();
     Lariat<int, nodesize> lar;
     for ( auto const& op : sc.Get() ) {
         int     val = std::get<2>( op );
         int     pos = std::get<1>( op );
         Action  a   = std::get<0>( op );
+        std::chrono::steady_clock::time_point op_start;
+        if ( timeEach ) {
+            op_start = std::chrono::steady_clock::now();
+        }
         switch ( a ) {
             case Insert:
                 lar.insert( pos, val );
@@ -956,12 +1047,16 @@ void run_scenario_cmp_to_vector_time // optimizations
                 lar.find( val );
                 break;
         }
+        if ( timeEach ) {
+            std::chrono::steady_clock::time_point op_end = std::chrono::steady_clock::now();
+            latencies[ a ].Record( static_cast<unsigned long long>(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>( op_end - op_start ).count() ) );
+        }
     }
     std::chrono::time_point<std::chrono::system_clock> end = std::chrono::system_clock::now();
     std::chrono::duration<double> elapsed_seconds = end-start;
     std::cout << "Lariat: time elapsed " << elapsed_seconds.count() << std::endl;
 
-
     start = std::chrono::system_clock::now();
     std::vector<int> v;
     for ( auto const& op : sc.Get() ) {
@@ -1028,7 +1123,10 @@ void run_scenario_cmp_to_vector_time // optimizations
         { Index      , "Index"      },
         { Find       , "Find"       }
     };
-    //sc.DrawStats( labels );
+    sc.DrawStats( labels );
+    if ( timeEach ) {
+        DrawLatencies( latencies, labels );
+    }
 }
 
 void test23()
@@ -1077,7 +1175,8 @@ void test25()
             1, 1,       // popfront, popback
             1,          // compact 
             1,          // index
-            1           // find
+            1,          // find
+            true        // latency histogram
             ); 
 }
 
@@ -1099,12 +1198,1365 @@ void test26()
             ); 
 }
 
+// single producer / single consumer queue
+#include <thread>
+void test27()
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    const int asize = 64;
+    const int count = 1<<20;
+    LariatQueue<int, asize> q;
+
+    std::thread producer( [&q]() {
+        int batch[100];
+        for( int i = 0; i < count; ) {
+            if ( i % 3 ) { // mix single and batch pushes
+                q.push( i++ );
+            } else {
+                int n = std::min( 100, count - i );
+                for ( int j = 0; j < n; ++j ) {
+                    batch[j] = i + j;
+                }
+                q.push( batch, n );
+                i += n;
+            }
+        }
+    } );
+
+    int expected = 0;
+    bool ordered = true;
+    int batch[37];
+    while ( expected < count ) {
+        int n = q.pop( batch, 37 );
+        for ( int j = 0; j < n; ++j ) {
+            if ( batch[j] != expected++ ) {
+                ordered = false;
+            }
+        }
+    }
+    producer.join();
+
+    std::cout << "Popped " << expected << ( ordered ? " in order" : " out of order" ) << std::endl;
+    std::cout << "Empty = " << q.empty() << std::endl;
+}
+
+void test28() // copy-on-write snapshots
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    const int asize = 4;
+    Lariat<int, asize> lar;
+    for( int i = 0; i < 10; ++i ) {
+        lar.push_back( i+1 );
+    }
+    Lariat<int, asize> snapshot( lar );
+    Lariat<int, asize> snapshot2;
+    snapshot2 = lar;
+
+    lar.insert( 5, 100 );
+    lar.erase( 1 );
+    lar[ 0 ] = 200;
+    lar.push_front( 300 );
+    lar.push_back( 400 );
+    lar.compact();
+    snapshot2.pop_front();
+    snapshot2.last() = 500;
+
+    std::cout << "Modified" << std::endl;
+    std::cout << lar << std::endl;
+    std::cout << "Snapshot" << std::endl;
+    std::cout << snapshot << std::endl;
+    std::cout << "Snapshot 2" << std::endl;
+    std::cout << snapshot2 << std::endl;
+
+    // references and segment pointers taken before a copy must not reach it
+    Lariat<int, 100> big;
+    for( int i = 0; i < 300; ++i ) {
+        big.push_back( i );
+    }
+    int &r = big[ 0 ];
+    int *data = ( *big.segments().begin() ).data;
+    Lariat<int, 100> copy( big );
+    Lariat<int, 100> assigned;
+    assigned = big;
+    r = 99;
+    data[ 1 ] = 77;
+    big.push_front( -1 );
+    std::cout << "list [1] = " << big[ 1 ] << " [2] = " << big[ 2 ]
+              << ", copies [0] = " << copy[ 0 ] << " " << assigned[ 0 ]
+              << " [1] = " << copy[ 1 ] << " " << assigned[ 1 ] << std::endl;
+
+    // assignment leaves the same state as a copy, a move doesn't allocate
+    Lariat<int, 16> small;
+    small.set_lazy_erase( true );
+    small.enable_index();
+    small.reserve( 64 );
+    for( int i = 0; i < 10; ++i ) {
+        small.push_back( i );
+    }
+    small.erase( 3 );
+    Lariat<int, 16> smallCopy( small );
+    Lariat<int, 16> smallAssigned;
+    smallAssigned.enable_zone_maps();
+    smallAssigned.reserve( 500 );
+    smallAssigned = small;
+    bool same = smallAssigned.indexed() == smallCopy.indexed() && smallAssigned.zone_mapped() == smallCopy.zone_mapped() &&
+                smallAssigned.capacity() == smallCopy.capacity() && smallCopy.capacity() == small.capacity();
+    Lariat<int, 16> moved( std::move( small ) );
+    smallAssigned = std::move( moved );
+    same = same && smallAssigned.size() == 9 && smallAssigned[ 3 ] == 4 && smallAssigned.find( 9 ) == 8 &&
+           small.size() == 0 && moved.size() == 0;
+    std::cout << "move is noexcept = " << std::is_nothrow_move_constructible<Lariat<int, 16> >::value
+              << std::is_nothrow_move_assignable<Lariat<int, 16> >::value
+              << " assignment matches copy = " << same << std::endl;
+}
+
+// binary save / load
+#include <sstream>
+void test29()
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    Lariat<int, 4> lar;
+    for( int i = 0; i < 10; ++i ) {
+        lar.insert( i/2, i+1 );
+    }
+    std::cout << lar << std::endl;
+
+    std::stringstream ss;
+    lar.save( ss );
+
+    Lariat<int, 7> loaded;
+    loaded.push_back( 42 ); // replaced by load
+    loaded.load( ss );
+    std::cout << "Loaded" << std::endl;
+    std::cout << loaded << std::endl;
+
+    try {
+        std::stringstream garbage( "not a lariat" );
+        loaded.load( garbage );
+    } catch ( LariatException & le ) {
+        std::cout << "Somethingbad happened: " << le.what() << std::endl;
+    }
+}
+
+// memory-mapped file-backed lariat
+#include <cstdio> /* std::remove */
+#include <fstream>
+void test30()
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    const char *path = "lariat_test30.bin";
+    std::remove( path );
+    {
+        LariatFile<int, 8> lar( path );
+        for( int i = 0; i < 1000; ++i ) {
+            lar.push_back( i );
+        }
+        for( int i = 0; i < 10; ++i ) {
+            lar.insert( 500, -i );
+            lar.push_front( 1000+i );
+        }
+        for( int i = 0; i < 100; ++i ) {
+            lar.erase( 200 );
+        }
+        lar.sync();
+        std::cout << "Size = " << lar.size() << " nodes = " << lar.nodes() << std::endl;
+    }
+
+    LariatFile<int, 8> lar;
+    lar.open( path );
+    std::cout << "Reopened size = " << lar.size() << " nodes = " << lar.nodes() << std::endl;
+    for( size_t i = 0; i < 12; ++i ) {
+        std::cout << lar[i] << " ";
+    }
+    std::cout << std::endl;
+    for( size_t i = 405; i < 425; ++i ) {
+        std::cout << lar[i] << " ";
+    }
+    std::cout << std::endl;
+
+    // freed blocks are reused before the file grows
+    size_t capacity = lar.capacity();
+    lar.clear();
+    for( int i = 0; i < 1000; ++i ) {
+        lar.push_front( i );
+    }
+    std::cout << "Capacity unchanged = " << ( capacity == lar.capacity() ) << std::endl;
+    size_t listed = lar.size();
+    lar.close();
+
+    // a file that grew without its header being updated still opens
+    std::streamoff length = std::ifstream( path, std::ios::binary | std::ios::ate ).tellg();
+    std::ofstream( path, std::ios::binary | std::ios::app ) << std::string( 4096, '\0' );
+    lar.open( path );
+    std::streamoff trimmed = std::ifstream( path, std::ios::binary | std::ios::ate ).tellg();
+    std::cout << "Grown file reopened = " << ( lar.size() == listed && lar[0] == 999 )
+              << " trimmed = " << ( trimmed == length ) << std::endl;
+    lar.close();
+
+    try {
+        LariatFile<int, 16> wrong( path );
+    } catch ( LariatException & le ) {
+        std::cout << "Somethingbad happened: " << le.what() << std::endl;
+    }
+    std::remove( path );
+}
+
+// buffered bulk output
+#include <climits>
+void test31()
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    Lariat<int, 4> lar;
+    for( int i = 0; i < 7; ++i ) {
+        lar.push_back( i*i - 10 );
+    }
+    lar.push_front( INT_MIN );
+    lar.push_back( INT_MAX );
+
+    std::stringstream text, dumped;
+    text << lar;
+    lar.dump( dumped );
+    std::cout << "Same as operator<< = " << ( text.str() == dumped.str() ) << std::endl;
+
+    lar.dump( std::cout, Lariat<int, 4>::DUMP_LINES );
+    lar.dump( std::cout, Lariat<int, 4>::DUMP_CSV );
+
+    Lariat<double, 3> dlar;
+    for( int i = 0; i < 5; ++i ) {
+        dlar.push_back( 1.0 / ( i+1 ) );
+    }
+    dlar.push_back( 1e300 );
+    dlar.dump( std::cout );
+
+    // stream flags are honored just like operator<< does
+    std::stringstream ftext, fdumped, htext, hdumped;
+    ftext << std::fixed << std::setprecision( 3 ) << dlar;
+    fdumped << std::fixed << std::setprecision( 3 );
+    dlar.dump( fdumped );
+    htext << std::hex << std::showpos << lar;
+    hdumped << std::hex << std::showpos;
+    lar.dump( hdumped );
+    std::cout << "Fixed same as operator<< = " << ( ftext.str() == fdumped.str() )
+              << " hex same = " << ( htext.str() == hdumped.str() ) << std::endl;
+
+    Lariat<std::string, 2> slar; // not arithmetic, goes through the stream
+    slar.push_back( "alpha" );
+    slar.push_back( "beta" );
+    slar.push_back( "gamma" );
+    slar.dump( std::cout, Lariat<std::string, 2>::DUMP_CSV );
+}
+
+// parallel bulk algorithms
+void test32()
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    Lariat<int, 1000> lar;
+    for( int i = 0; i < 1000000; ++i ) {
+        lar.push_back( i % 1000 );
+    }
+    for( int i = 0; i < 1000; ++i ) {
+        lar.insert( i * 997, 7 ); // leave some nodes half full
+    }
+    Lariat<int, 1000> snapshot( lar );
+
+    lar.transform( []( int x ) { return 3 * x; }, 4 );
+
+    long long sum = lar.reduce( 0LL, []( long long a, long long b ) { return a + b; }, 4 );
+    long long sum1 = lar.reduce( 0LL, []( long long a, long long b ) { return a + b; } );
+    int max = lar.reduce( -1, []( int a, int b ) { return std::max( a, b ); }, 3 );
+    std::cout << "Sum = " << sum << " single threaded = " << sum1 << std::endl;
+    std::cout << "Max = " << max << std::endl;
+
+    int sevens = 0;
+    snapshot.for_each( [&sevens]( int const& x ) { sevens += ( x == 7 ); } );
+    std::cout << "Snapshot sevens = " << sevens << std::endl;
+
+    lar.for_each( []( int & x ) { x -= 1; }, 0 );
+    std::cout << "First = " << lar[0] << " last = " << lar[ lar.size() - 1 ] << std::endl;
+
+    Lariat<int, 8> empty;
+    std::cout << "Empty sum = " << empty.reduce( 5, []( int a, int b ) { return a + b; }, 4 ) << std::endl;
+}
+
+// segmented access
+#include <numeric>
+void test33()
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    Lariat<int, 5> lar;
+    for( int i = 0; i < 12; ++i ) {
+        lar.insert( i/3, i );
+    }
+    std::cout << lar << std::endl;
+    Lariat<int, 5> const snapshot( lar );
+
+    // copy out node by node
+    std::vector<int> buffer( lar.size() );
+    size_t offset = 0;
+    for ( auto segment : snapshot.segments() ) {
+        std::memcpy( &buffer[offset], segment.data, sizeof(int) * static_cast<size_t>( segment.count ) );
+        offset += static_cast<size_t>( segment.count );
+    }
+    for ( int value : buffer ) {
+        std::cout << value << " ";
+    }
+    std::cout << std::endl;
+
+    // kernel over each span, writes only touch lar
+    int sum = 0;
+    for ( auto segment : lar.segments() ) {
+        std::cout << "span of " << segment.count << std::endl;
+        for ( int & value : segment ) {
+            value *= 10;
+        }
+        sum = std::accumulate( segment.begin(), segment.end(), sum );
+    }
+    std::cout << "Sum = " << sum << std::endl;
+    std::cout << "lar[4] = " << lar[4] << " snapshot[4] = " << snapshot[4] << std::endl;
+}
+
+#include <stdexcept>
+// sort and stable_sort
+void test34()
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    RandomNumber rn( 0, 1000000 );
+    Lariat<int, 64> lar;
+    std::vector<int> v;
+    for( int i = 0; i < 100000; ++i ) {
+        int value = rn.GetInt( 5000 );
+        lar.insert( rn.GetInt( i+1 ), value );
+        v.push_back( value );
+    }
+    Lariat<int, 64> snapshot( lar );
+    lar.sort( std::less<int>(), 4 );
+    std::sort( v.begin(), v.end() );
+    bool same = lar.size() == v.size();
+    for( unsigned i = 0; same && i < v.size(); ++i ) {
+        same = lar[ i ] == v[i];
+    }
+    std::cout << "Sorted like std::sort = " << same << std::endl;
+    std::cout << "Snapshot unchanged size = " << snapshot.size() << std::endl;
+
+    snapshot.sort( std::greater<int>(), 2 );
+    std::cout << "Descending first = " << snapshot.first() << " last = " << snapshot.last() << std::endl;
+
+    // stable: order by tens only, ones digit records the original order
+    Lariat<int, 3> slar;
+    int values[] = { 31, 12, 23, 11, 32, 21, 13, 22, 33, 14 };
+    for( int value : values ) {
+        slar.push_front( value );
+    }
+    slar.stable_sort( []( int a, int b ) { return a / 10 < b / 10; } );
+    std::cout << slar << std::endl;
+
+    Lariat<int, 3> empty;
+    empty.sort();
+    std::cout << "Empty size = " << empty.size() << std::endl;
+
+    // a comparator that throws halfway through the merge loses no items
+    Lariat<int, 1> tlar;
+    for( int i = 0; i < 64; ++i ) {
+        tlar.push_back( ( i * 37 ) % 64 );
+    }
+    int calls = 0;
+    try {
+        tlar.sort( [&calls]( int a, int b ) {
+            if ( ++calls == 100 ) {
+                throw std::runtime_error( "comparator" );
+            }
+            return a < b;
+        }, 2 );
+    } catch ( std::runtime_error const& e ) {
+        std::cout << "Caught " << e.what() << std::endl;
+    }
+    int sum = 0;
+    for( unsigned i = 0; i < tlar.size(); ++i ) {
+        sum += tlar[ i ];
+    }
+    std::cout << "Size = " << tlar.size() << " sum = " << sum << std::endl;
+}
+
+// deque-style use of a lariat with large nodes
+#include <deque>
+void test35()
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    Lariat<int, 5000> lar;
+    std::deque<int> d;
+    for( int i = 0; i < 300000; ++i ) {
+        switch ( i % 7 ) {
+            case 0: case 1: case 2:
+                lar.push_front( i ); d.push_front( i );
+                break;
+            case 3: case 4:
+                lar.push_back( i ); d.push_back( i );
+                break;
+            case 5:
+                lar.pop_front(); d.pop_front();
+                break;
+            case 6:
+                lar.insert( 3, i ); d.insert( d.begin()+3, i );
+                break;
+        }
+    }
+    bool same = lar.size() == d.size();
+    for( unsigned i = 0; same && i < d.size(); ++i ) {
+        same = lar[ i ] == d[i];
+    }
+    std::cout << "Size = " << lar.size() << " matches deque = " << same << std::endl;
+    while ( lar.size() ) {
+        lar.pop_front();
+    }
+    std::cout << "Size = " << lar.size() << std::endl;
+}
+
+// gap buffer mode, editor-like typing and deleting around a cursor
+void test36()
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    Lariat<char, 4096> lar;
+    std::string text;
+    for( int i = 0; i < 20000; ++i ) {
+        char c = static_cast<char>( 'a' + i % 26 );
+        lar.push_back( c );
+        text.push_back( c );
+    }
+    lar.set_gap_buffer( true );
+    RandomNumber rn( 0, 1000000 );
+    int cursor = 1000;
+    for( int i = 0; i < 200000; ++i ) {
+        if ( i % 500 == 0 ) { // jump somewhere else now and then
+            cursor = 1 + rn.GetInt( static_cast<int>( text.size() ) - 2 );
+        }
+        if ( i % 5 == 4 ) { // backspace
+            --cursor;
+            lar.erase( cursor );
+            text.erase( static_cast<size_t>( cursor ), 1 );
+        } else {            // type
+            char c = static_cast<char>( 'A' + i % 26 );
+            lar.insert( cursor, c );
+            text.insert( static_cast<size_t>( cursor ), 1, c );
+            ++cursor;
+        }
+    }
+    bool same = lar.size() == text.size();
+    for( unsigned i = 0; same && i < text.size(); ++i ) {
+        same = lar[ i ] == text[i];
+    }
+    std::cout << "Size = " << lar.size() << " matches string = " << same << std::endl;
+
+    Lariat<char, 4096> copy( lar ); // the copy sees the same gap
+    lar.set_gap_buffer( false );
+    same = true;
+    for( unsigned i = 0; same && i < text.size(); ++i ) {
+        same = lar[ i ] == text[i] && copy[ i ] == text[i];
+    }
+    std::cout << "After closing the gap = " << same << std::endl;
+}
+
+// reserve / capacity / shrink_to_fit
+#ifdef LARIAT_ALLOC_STATS
+namespace AllocStats { extern std::atomic<long long> calls; } // see test42
+#endif
+
+// fills a list that reserved room for 995 items, reporting whether it allocated
+template < typename Fill >
+void ReservedFill( const char *name, Fill fill )
+{
+    Lariat<int, 10> lar;
+    lar.reserve( 995 );
+    size_t reserved = lar.capacity();
+#ifdef LARIAT_ALLOC_STATS
+    AllocStats::calls = 0;
+#endif
+    for( int i = 0; i < 995; ++i ) {
+        fill( lar, i );
+    }
+    std::cout << name << ": size = " << lar.size() << " capacity unchanged = " << ( lar.capacity() == reserved );
+#ifdef LARIAT_ALLOC_STATS
+    std::cout << " allocations = " << AllocStats::calls.load();
+#endif
+    std::cout << std::endl;
+}
+
+void test37()
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    Lariat<int, 10> lar;
+    std::cout << "Capacity = " << lar.capacity() << std::endl;
+    lar.reserve( 995 );
+    std::cout << "Reserved capacity = " << lar.capacity() << std::endl;
+    for( int i = 0; i < 500; ++i ) {
+        lar.push_back( i );
+    }
+    std::cout << "Size = " << lar.size() << " capacity = " << lar.capacity() << std::endl;
+    for( int i = 0; i < 250; ++i ) {
+        lar.pop_front();
+    }
+    std::cout << "Size = " << lar.size() << " capacity = " << lar.capacity() << std::endl;
+    lar.shrink_to_fit();
+    std::cout << "Size = " << lar.size() << " capacity = " << lar.capacity() << std::endl;
+    std::cout << "lar[0] = " << lar[0] << " lar[249] = " << lar[249] << std::endl;
+    lar.clear();
+    std::cout << "Cleared capacity = " << lar.capacity() << std::endl;
+
+    // splits leave nodes only half full, reserve counts on that
+    ReservedFill( "push_back", []( Lariat<int, 10> &l, int i ) { l.push_back( i ); } );
+    ReservedFill( "push_front", []( Lariat<int, 10> &l, int i ) { l.push_front( i ); } );
+    ReservedFill( "insert in the middle", []( Lariat<int, 10> &l, int i ) { l.insert( l.size() / 2, i ); } );
+    ReservedFill( "random insert", []( Lariat<int, 10> &l, int i ) {
+        l.insert( static_cast<size_t>( i * 7919 ) % ( l.size() + 1 ), i );
+    } );
+}
+
+
+// value index kept up to date through every kind of edit
+void test38()
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    Lariat<unsigned, 64> lar;
+    std::vector<unsigned> vec;
+    lar.enable_index();
+    lar.set_gap_buffer( true );
+    RandomNumber rn( 0, 1000000 );
+    int mismatches = 0;
+    for( int i = 0; i < 100000; ++i ) {
+        unsigned value = static_cast<unsigned>( rn.GetInt( 5000 ) );
+        int size = static_cast<int>( vec.size() );
+        switch ( rn.GetInt( 8 ) ) {
+            case 0: case 1: case 2: { // insert
+                int pos = rn.GetInt( size + 1 );
+                lar.insert( pos, value );
+                vec.insert( vec.begin() + pos, value );
+                break; }
+            case 3: lar.push_back( value );  vec.push_back( value ); break;
+            case 4: lar.push_front( value ); vec.insert( vec.begin(), value ); break;
+            case 5: if ( size ) { // erase
+                int pos = rn.GetInt( size );
+                lar.erase( pos );
+                vec.erase( vec.begin() + pos );
+                } break;
+            case 6: if ( size ) {
+                if ( i % 2 ) { lar.pop_back(); vec.pop_back(); }
+                else { lar.pop_front(); vec.erase( vec.begin() ); }
+                } break;
+            default: if ( i % 1000 == 7 ) { lar.compact(); } break;
+        }
+        Lariat<unsigned, 64> const& clar = lar;
+        unsigned expected = static_cast<unsigned>( std::find( vec.begin(), vec.end(), value ) - vec.begin() );
+        mismatches += clar.find( value ) != expected;
+    }
+    std::cout << "Matches vector = " << ( lar.size() == vec.size() ) << " mismatches = " << mismatches << std::endl;
+
+    lar[ 0 ] = 777777;  // written through a reference, rebuilt on the next find
+    vec[ 0 ] = 777777;
+    lar.sort();
+    std::sort( vec.begin(), vec.end() );
+    Lariat<unsigned, 64> copy( lar );
+    for( unsigned value = 0; value < 5000; ++value ) {
+        unsigned expected = static_cast<unsigned>( std::lower_bound( vec.begin(), vec.end(), value ) - vec.begin() );
+        if ( value != vec[ expected ] ) {
+            expected = static_cast<unsigned>( vec.size() );
+        }
+        mismatches += lar.find( value ) != expected;
+        mismatches += copy.find( value ) != expected;
+    }
+    std::cout << "After sort: indexed = " << copy.indexed() << " mismatches = " << mismatches
+              << " find(777777) is last = " << ( lar.find( 777777 ) + 1 == lar.size() ) << std::endl;
+
+    // element access only takes its own node out of the index
+    mismatches = 0;
+    for( int i = 0; i < 20000; ++i ) {
+        int pos = rn.GetInt( static_cast<int>( vec.size() ) );
+        unsigned value = static_cast<unsigned>( rn.GetInt( 5000 ) );
+        if ( i % 3 ) {
+            mismatches += lar[ pos ] != vec[ pos ];
+        } else {
+            lar[ pos ] = value;
+            vec[ pos ] = value;
+        }
+        unsigned expected = static_cast<unsigned>( std::find( vec.begin(), vec.end(), value ) - vec.begin() );
+        mismatches += lar.find( value ) != expected;
+        mismatches += lar.count( value ) != static_cast<size_t>( std::count( vec.begin(), vec.end(), value ) );
+    }
+
+    // const queries only read, so several threads can share the list; they
+    // also scan the node first() took out of the index
+    lar.first() = 888888;
+    vec.front() = 888888;
+    std::atomic<int> threadMismatches( 0 );
+    std::vector<std::thread> threads;
+    for( int t = 0; t < 4; ++t ) {
+        threads.push_back( std::thread( [&lar, &vec, &threadMismatches, t]() {
+            Lariat<unsigned, 64> const& clar = lar;
+            for( unsigned value = static_cast<unsigned>( t ); value < 5000; value += 4 ) {
+                unsigned expected = static_cast<unsigned>( std::find( vec.begin(), vec.end(), value ) - vec.begin() );
+                threadMismatches += clar.find( value ) != expected;
+            }
+            threadMismatches += clar.find( 888888 ) != 0;
+        } ) );
+    }
+    for( std::thread &thread : threads ) {
+        thread.join();
+    }
+    std::cout << "After element access: mismatches = " << mismatches
+              << " from threads = " << threadMismatches << std::endl;
+}
+
+
+// small lists live in the inline node
+void test39()
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    Lariat<int, 8> a;
+    for( int i = 0; i < 5; ++i ) {
+        a.push_back( i );
+    }
+    Lariat<int, 8> b( a );      // the inline node is copied, not shared
+    b[ 0 ] = 100;
+    std::cout << a << b;
+    Lariat<int, 8> c( std::move( a ) );
+    std::cout << "moved from size = " << a.size() << std::endl << c;
+    for( int i = 5; i < 20; ++i ) { // overflow into heap nodes, then empty it
+        c.push_front( i );
+    }
+    std::cout << c;
+    while ( c.size() ) {
+        c.pop_front();
+    }
+    c.push_back( 42 );
+    a = std::move( b );
+    b = c;
+    std::cout << a << b << c;
+
+    std::vector< Lariat<int, 8> > lists;
+    for( int i = 0; i < 1000; ++i ) {
+        Lariat<int, 8> list;
+        for( int j = 0; j <= i % 12; ++j ) {
+            list.push_back( j );
+        }
+        lists.push_back( std::move( list ) );
+    }
+    long sum = 0;
+    for( unsigned i = 0; i < lists.size(); ++i ) {
+        for( unsigned j = 0; j < lists[i].size(); ++j ) {
+            sum += lists[i][ j ];
+        }
+    }
+    std::cout << "Sum over " << lists.size() << " lists = " << sum << std::endl;
+}
+
+
+// size_t indices over 64K nodes: 2^bits + 1000 one byte elements, then
+// lookups, inserts and erases past 2^bits. push_back leaves full nodes half
+// empty, so the list is compacted every 2^27 elements to keep it near 1 byte
+// per element.
+void test_big_indices( int bits )
+{
+    typedef Lariat<unsigned char, 1 << 16> Bytes;
+    const size_t base = static_cast<size_t>( 1 ) << bits;
+    const size_t big = base + 1000;
+    const size_t compactEvery = static_cast<size_t>( 1 ) << 27;
+    Bytes lar;
+    for( size_t i = 0; i < big; ++i ) {
+        lar.push_back( static_cast<unsigned char>( i % 251 ) );
+        if ( ( i + 1 ) % compactEvery == 0 ) {
+            lar.compact();
+        }
+    }
+    Bytes const& clar = lar;
+    std::cout << "Size = " << lar.size() << std::endl;
+    std::cout << "lar[2^" << bits << "] = " << int( clar[ base ] )
+              << " last = " << int( clar.last() )
+              << " expected " << ( base % 251 )
+              << " " << ( ( big - 1 ) % 251 ) << std::endl;
+
+    const size_t pos = base + 5;
+    lar.insert( pos, 255 ); // a value the fill never produces
+    std::cout << "find(255) = " << lar.find( 255 ) << std::endl;
+    lar.erase( pos );
+    std::cout << "after erase find(255) = " << lar.find( 255 ) << " size = " << lar.size() << std::endl;
+    try {
+        lar.erase( big );
+    } catch( LariatException const& e ) {
+        std::cout << "erase(" << big << ") " << e.what() << std::endl;
+    }
+    try { // would be index 5 if it were cut down to 32 bits
+        lar.erase( ( static_cast<size_t>( 1 ) << 32 ) + 5 );
+    } catch( LariatException const& e ) {
+        std::cout << "erase(2^32 + 5) " << e.what() << " size = " << lar.size() << std::endl;
+    }
+    try {
+        lar.insert( static_cast<size_t>( -1 ), 0 );
+    } catch( LariatException const& e ) {
+        std::cout << "insert(-1) " << e.what() << std::endl;
+    }
+}
+
+void test40()
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    test_big_indices( 20 );
+}
+
+// more than 2^31 one byte elements, needs about 2.3 GB and most of a
+// minute, so it only runs as gnu.exe huge
+void test_huge()
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    test_big_indices( 31 );
+}
+
+// replays a trace recorded by LariatRecorder: first the list alone for
+// throughput, then (check) together with a std::vector comparing every result
+template < typename T, int nodesize >
+void replay_trace( std::istream & trace, bool check )
+{
+    LariatTraceReader reader( trace );
+    std::vector<LariatTraceOp> ops; // decoded up front so only the list is timed
+    for ( LariatTraceOp op; reader.next( op ); ) {
+        ops.push_back( op );
+    }
+
+    long long sink = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    {
+        Lariat<T, nodesize> lar;
+        for ( auto const& op : ops ) {
+            T val = static_cast<T>( op.value );
+            switch ( op.op ) {
+                case LariatTrace::INSERT:     lar.insert( op.index, val ); break;
+                case LariatTrace::PUSH_BACK:  lar.push_back( val );        break;
+                case LariatTrace::PUSH_FRONT: lar.push_front( val );       break;
+                case LariatTrace::COMPACT:    lar.compact();               break;
+                case LariatTrace::ERASE:      lar.erase( op.index );       break;
+                case LariatTrace::POP_BACK:   lar.pop_back();              break;
+                case LariatTrace::POP_FRONT:  lar.pop_front();             break;
+                case LariatTrace::INDEX:
+                    sink += static_cast<long long>( static_cast<Lariat<T, nodesize> const&>( lar )[ op.index ] );
+                    break;
+                case LariatTrace::FIND:
+                    sink += static_cast<long long>( lar.find( val ) );
+                    break;
+            }
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Replayed " << ops.size() << " operations in " << elapsed.count() << " s ("
+              << static_cast<double>( ops.size() ) / elapsed.count() << " ops/s, checksum " << sink << ")" << std::endl;
+    if ( !check ) {
+        return;
+    }
+
+    Lariat<T, nodesize> lar;
+    std::vector<T> v;
+    int mismatches = 0;
+    for ( auto const& op : ops ) {
+        T val = static_cast<T>( op.value );
+        auto pos = static_cast<typename std::vector<T>::difference_type>( op.index );
+        switch ( op.op ) {
+            case LariatTrace::INSERT:     lar.insert( op.index, val ); v.insert( v.begin() + pos, val ); break;
+            case LariatTrace::PUSH_BACK:  lar.push_back( val );        v.push_back( val );               break;
+            case LariatTrace::PUSH_FRONT: lar.push_front( val );       v.insert( v.begin(), val );       break;
+            case LariatTrace::COMPACT:    lar.compact();                                                 break;
+            case LariatTrace::ERASE:      lar.erase( op.index );       v.erase( v.begin() + pos );       break;
+            case LariatTrace::POP_BACK:   lar.pop_back();              v.pop_back();                     break;
+            case LariatTrace::POP_FRONT:  lar.pop_front();             v.erase( v.begin() );             break;
+            case LariatTrace::INDEX:
+                mismatches += static_cast<Lariat<T, nodesize> const&>( lar )[ op.index ] != v[ op.index ];
+                break;
+            case LariatTrace::FIND:
+                mismatches += lar.find( val ) != static_cast<size_t>( std::find( v.begin(), v.end(), val ) - v.begin() );
+                break;
+        }
+    }
+    bool same = lar.size() == v.size();
+    for ( size_t i = 0; same && i < v.size(); ++i ) {
+        same = static_cast<Lariat<T, nodesize> const&>( lar )[ i ] == v[ i ];
+    }
+    std::cout << "Checked against std::vector: mismatches = " << mismatches << " final contents match = " << same << std::endl;
+}
+
+// record a random workload, then replay it with other node sizes and types
+void test41()
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    LariatScenario sc( 20000, 2000, 4, 1, 4, 2, 1, 1, 1, 1, 1 );
+    std::stringstream trace;
+    {
+        Lariat<int, 16> lar;
+        LariatRecorder<int, 16> rec( lar, trace );
+        for ( auto const& op : sc.Get() ) {
+            int     val = std::get<2>( op );
+            int     pos = std::get<1>( op );
+            switch ( std::get<0>( op ) ) {
+                case Insert:    rec.insert( static_cast<size_t>( pos ), val ); break;
+                case Erase:     rec.erase( static_cast<size_t>( pos ) );       break;
+                case Pushback:  rec.push_back( val );   break;
+                case Pushfront: rec.push_front( val );  break;
+                case Popfront:  rec.pop_front();        break;
+                case Popback:   rec.pop_back();         break;
+                case Compact:   rec.compact();          break;
+                case Index:     rec[ static_cast<size_t>( pos ) ]; break;
+                case Find:      rec.find( val );        break;
+            }
+        }
+    }
+    std::cout << "Bytes per operation < 4 = " << ( trace.str().size() < 4 * sc.Get().size() ) << std::endl;
+    replay_trace<long long, 5000>( trace, true );
+    trace.clear();
+    trace.seekg( 0 );
+    replay_trace<int, 7>( trace, true );
+}
+
+
+// allocation tracking, only built with -DLARIAT_ALLOC_STATS (make stats):
+// every global operator new/delete in this program then goes through these
+// counters. Each block carries a header in front of it holding its size, so
+// the bytes counted are the requested size plus that header; rounding inside
+// malloc itself isn't seen.
+#ifdef LARIAT_ALLOC_STATS
+#include <new>
+#include <cstdlib>
+#include <cstddef> // std::max_align_t
+namespace AllocStats {
+    std::atomic<long long> live( 0 ), peak( 0 ), calls( 0 );
+
+    const size_t header = alignof( std::max_align_t ); // keeps the block aligned
+
+    void *Add( size_t size )
+    {
+        char *chunk = static_cast<char *>( std::malloc( header + ( size ? size : 1 ) ) );
+        if ( !chunk ) {
+            return nullptr;
+        }
+        *reinterpret_cast<size_t *>( chunk ) = size;
+        long long bytes = static_cast<long long>( header + size );
+        long long now = live.fetch_add( bytes, std::memory_order_relaxed ) + bytes;
+        calls.fetch_add( 1, std::memory_order_relaxed );
+        long long high = peak.load( std::memory_order_relaxed );
+        while ( now > high && !peak.compare_exchange_weak( high, now, std::memory_order_relaxed ) ) {}
+        return chunk + header;
+    }
+    void Remove( void *p )
+    {
+        char *chunk = static_cast<char *>( p ) - header;
+        size_t size = *reinterpret_cast<size_t *>( chunk );
+        live.fetch_sub( static_cast<long long>( header + size ), std::memory_order_relaxed );
+        std::free( chunk );
+    }
+}
+
+void *operator new( size_t size )
+{
+    void *p = AllocStats::Add( size );
+    if ( !p ) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void *operator new[]( size_t size )      { return operator new( size ); }
+void operator delete( void *p ) noexcept
+{
+    if ( p ) {
+        AllocStats::Remove( p );
+    }
+}
+void operator delete[]( void *p ) noexcept { operator delete( p ); }
+void *operator new( size_t size, std::nothrow_t const& ) noexcept { return AllocStats::Add( size ); }
+void *operator new[]( size_t size, std::nothrow_t const& tag ) noexcept { return operator new( size, tag ); }
+void operator delete( void *p, std::nothrow_t const& ) noexcept         { operator delete( p ); }
+void operator delete[]( void *p, std::nothrow_t const& ) noexcept       { operator delete( p ); }
+#endif
+
+// the same workloads for Lariat and the standard sequences
+template < int nodesize >
+void InsertAt( Lariat<int, nodesize> & c, size_t pos, int value ) { c.insert( pos, value ); }
+template < typename C >
+void InsertAt( C & c, size_t pos, int value ) { c.insert( c.begin() + static_cast<long>( pos ), value ); }
+
+template < typename C >
+size_t WorkloadPushBack( C & c )
+{
+    for( int i = 0; i < 1000000; ++i ) {
+        c.push_back( i );
+    }
+    return c.size();
+}
+template < typename C >
+size_t WorkloadPushFront( C & c )
+{
+    for( int i = 0; i < 1000000; ++i ) {
+        c.push_front( i );
+    }
+    return c.size();
+}
+template < typename C >
+size_t WorkloadRandomInsert( C & c ) // leaves nodes half full after splits
+{
+    RandomNumber rn( 0, 1000000000 );
+    for( int i = 0; i < 50000; ++i ) {
+        InsertAt( c, static_cast<size_t>( rn.GetInt( static_cast<int>( c.size() ) + 1 ) ), i );
+    }
+    return c.size();
+}
+
+#ifdef LARIAT_ALLOC_STATS
+template < typename C, typename Workload >
+void MeasureAllocations( const char *workload, const char *container, Workload run )
+{
+    long long base = AllocStats::live.load();
+    AllocStats::peak = base;
+    AllocStats::calls = 0;
+    size_t count = 0;
+    long long live = 0;
+    {
+        C c;
+        count = run( c );
+        live = AllocStats::live.load() - base;
+    }
+    std::cout << std::left << std::setw( 14 ) << workload << std::setw( 14 ) << container << std::right
+              << std::setw( 12 ) << AllocStats::peak.load() - base
+              << std::setw( 12 ) << std::fixed << std::setprecision( 2 ) << static_cast<double>( live ) / static_cast<double>( count )
+              << std::setw( 10 ) << AllocStats::calls.load() << std::endl;
+    std::cout.unsetf( std::ios::floatfield );
+}
+
+#endif
+
+void test42()
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+#ifndef LARIAT_ALLOC_STATS
+    std::cout << "allocation tracking is off, build with make stats" << std::endl;
+#else
+    std::cout << std::left << std::setw( 14 ) << "workload" << std::setw( 14 ) << "container" << std::right
+              << std::setw( 12 ) << "peak bytes" << std::setw( 12 ) << "bytes/elem" << std::setw( 10 ) << "allocs" << std::endl;
+    MeasureAllocations< Lariat<int, 16> >(  "push_back", "Lariat<16>",  WorkloadPushBack< Lariat<int, 16> > );
+    MeasureAllocations< Lariat<int, 64> >(  "push_back", "Lariat<64>",  WorkloadPushBack< Lariat<int, 64> > );
+    MeasureAllocations< Lariat<int, 512> >( "push_back", "Lariat<512>", WorkloadPushBack< Lariat<int, 512> > );
+    MeasureAllocations< std::vector<int> >( "push_back", "vector",      WorkloadPushBack< std::vector<int> > );
+    MeasureAllocations< std::deque<int> >(  "push_back", "deque",       WorkloadPushBack< std::deque<int> > );
+
+    MeasureAllocations< Lariat<int, 16> >(  "push_front", "Lariat<16>",  WorkloadPushFront< Lariat<int, 16> > );
+    MeasureAllocations< Lariat<int, 64> >(  "push_front", "Lariat<64>",  WorkloadPushFront< Lariat<int, 64> > );
+    MeasureAllocations< Lariat<int, 512> >( "push_front", "Lariat<512>", WorkloadPushFront< Lariat<int, 512> > );
+    MeasureAllocations< std::deque<int> >(  "push_front", "deque",       WorkloadPushFront< std::deque<int> > );
+
+    MeasureAllocations< Lariat<int, 16> >(  "random insert", "Lariat<16>",  WorkloadRandomInsert< Lariat<int, 16> > );
+    MeasureAllocations< Lariat<int, 64> >(  "random insert", "Lariat<64>",  WorkloadRandomInsert< Lariat<int, 64> > );
+    MeasureAllocations< Lariat<int, 512> >( "random insert", "Lariat<512>", WorkloadRandomInsert< Lariat<int, 512> > );
+    MeasureAllocations< std::vector<int> >( "random insert", "vector",      WorkloadRandomInsert< std::vector<int> > );
+    MeasureAllocations< std::deque<int> >(  "random insert", "deque",       WorkloadRandomInsert< std::deque<int> > );
+#endif
+}
+
+
+// rebalance leaves room for inserts that compact doesn't
+void test43()
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    Lariat<int, 100> packed, spaced;
+    std::vector<int> v;
+    for( int i = 0; i < 10000; ++i ) {
+        packed.push_back( i );
+        spaced.push_back( i );
+        v.push_back( i );
+    }
+    packed.compact();
+    spaced.rebalance( 0.75 );
+    std::cout << "compact capacity = " << packed.capacity()
+              << " rebalance(0.75) capacity = " << spaced.capacity() << std::endl;
+    for( int i = 0; i < 2000; ++i ) {
+        size_t pos = static_cast<size_t>( i ) * 37 % v.size();
+        packed.insert( pos, -i );
+        spaced.insert( pos, -i );
+        v.insert( v.begin() + static_cast<long>( pos ), -i );
+    }
+    std::cout << "after 2000 inserts: compact capacity = " << packed.capacity()
+              << " rebalance(0.75) capacity = " << spaced.capacity() << std::endl;
+    spaced.rebalance( 0.5 );
+    std::cout << "rebalance(0.5) capacity = " << spaced.capacity() << std::endl;
+    spaced.rebalance( 1.0 );
+    bool same = spaced.size() == v.size() && packed.size() == v.size();
+    for( size_t i = 0; same && i < v.size(); ++i ) {
+        same = spaced[ i ] == v[ i ] && packed[ i ] == v[ i ];
+    }
+    std::cout << "rebalance(1.0) capacity = " << spaced.capacity() << " matches vector = " << same << std::endl;
+}
+
+
+void test44()
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    Lariat<int, 64> lazy;
+    std::vector<int> v;
+    lazy.set_lazy_erase( true );
+    for( int i = 0; i < 20000; ++i ) {
+        lazy.push_back( i );
+        v.push_back( i );
+    }
+    // erase-heavy: drop two of every three elements from scattered positions
+    for( int i = 0; i < 13000; ++i ) {
+        size_t pos = static_cast<size_t>( i ) * 7919 % v.size();
+        lazy.erase( pos );
+        v.erase( v.begin() + static_cast<long>( pos ) );
+    }
+    bool same = lazy.size() == v.size();
+    for( size_t i = 0; same && i < v.size(); ++i ) {
+        same = lazy[ i ] == v[ i ];
+    }
+    std::cout << "lazy erase matches vector = " << same << std::endl;
+    bool found = lazy.find( v[ v.size() / 2 ] ) == v.size() / 2 && lazy.find( -1 ) == lazy.size();
+    Lariat<int, 64> copy( lazy );
+    lazy.compact();
+    same = copy.size() == v.size() && lazy.size() == v.size();
+    for( size_t i = 0; same && i < v.size(); ++i ) {
+        same = copy[ i ] == v[ i ] && lazy[ i ] == v[ i ];
+    }
+    std::cout << "find = " << found << " copy and compact match = " << same << std::endl;
+
+    // const members read around the dead slots, a reference stays where it is
+    Lariat<int, 16> probe;
+    probe.set_lazy_erase( true );
+    for( int i = 0; i < 10; ++i ) {
+        probe.push_back( i );
+    }
+    probe.erase( 3 );
+    const int &ref = probe[ 5 ];
+    const Lariat<int, 16> &view = probe;
+    std::ostringstream text;
+    text << view;
+    view.dump( text );
+    std::stringstream saved;
+    view.save( saved );
+    Lariat<int, 16> loaded;
+    loaded.load( saved );
+    int visited = 0;
+    view.for_each( [&visited]( const int &value ) { visited += value; } );
+    int spans = 0;
+    for( auto segment : view.segments() ) {
+        spans += std::accumulate( segment.begin(), segment.end(), 0 );
+    }
+    Lariat<int, 16> copy2( view );
+    bool kept = view.find( 100 ) == view.size() && view.count( 7 ) == 1 && ref == 6 &&
+                view.reduce( 0, std::plus<int>() ) == 42 && visited == 42 && spans == 42 &&
+                loaded.size() == 9 && loaded[ 3 ] == 4 && copy2[ 3 ] == 4;
+    copy2.erase( 2 );
+    kept = kept && ref == 6 && copy2[ 4 ] == 6;
+    Lariat<char, 16> words;
+    words.set_lazy_erase( true );
+    words.insert( 0, std::string( "lazy xerase" ) );
+    words.erase( 5 );
+    const Lariat<char, 16> &wordView = words;
+    kept = kept && wordView.find( std::string( "y era" ) ) == 3 && wordView.substr( 2, 6 ) == "zy era";
+    std::cout << "const reads keep references = " << kept << std::endl;
+}
+
+
+struct Record256 {
+    int  key;
+    char payload[252];
+    bool operator==( const Record256 &rhs ) const { return key == rhs.key; }
+};
+
+void test45()
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    LariatIndirect<Record256, 32> lar;
+    std::vector<int> v;
+    Record256 r = {};
+    for( int i = 0; i < 1000; ++i ) {
+        r.key = i;
+        lar.push_back( r );
+        v.push_back( i );
+    }
+    Record256 &watched = lar[ 500 ];
+    for( int i = 0; i < 3000; ++i ) {
+        size_t pos = static_cast<size_t>( i ) * 131 % ( v.size() + 1 );
+        r.key = -i;
+        lar.insert( pos, r );
+        v.insert( v.begin() + static_cast<long>( pos ), -i );
+        if ( i % 3 == 0 ) {
+            pos = static_cast<size_t>( i ) * 17 % v.size();
+            if ( v[ pos ] != 500 ) {
+                lar.erase( pos );
+                v.erase( v.begin() + static_cast<long>( pos ) );
+            }
+        }
+    }
+    lar.compact();
+    bool stable = watched.key == 500 && &lar[ lar.find( watched ) ] == &watched;
+    LariatIndirect<Record256, 32> copy( lar );
+    bool same = lar.size() == v.size() && copy.size() == v.size();
+    for( size_t i = 0; same && i < v.size(); ++i ) {
+        same = lar[ i ].key == v[ i ] && copy[ i ].key == v[ i ] && &copy[ i ] != &lar[ i ];
+    }
+    std::cout << "reference stable = " << stable << " matches vector = " << same << std::endl;
+    while ( lar.size() > 10 ) {
+        lar.pop_front();
+    }
+    size_t slots = lar.capacity();
+    for( int i = 0; i < 1000; ++i ) {
+        r.key = i;
+        lar.push_back( r );
+    }
+    std::cout << "erased slots reused = " << ( lar.capacity() == slots ) << std::endl;
+    try {
+        lar.erase( lar.size() );
+    } catch( LariatException const& e ) {
+        std::cout << "erase(size()) " << e.what() << " size = " << lar.size() << std::endl;
+    }
+}
+
+
+void test46()
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    Lariat<int, 64> window;
+    std::deque<int> d;
+    window.set_max_size( 1000 );
+    for( int i = 0; i < 5000; ++i ) {
+        window.push_back( i );
+        d.push_back( i );
+        if ( d.size() > 1000 ) {
+            d.pop_front();
+        }
+    }
+    // steady state: every push_back evicts one item and reuses emptied nodes
+    size_t capacity = window.capacity();
+#ifdef LARIAT_ALLOC_STATS
+    AllocStats::calls = 0;
+#endif
+    for( int i = 5000; i < 100000; ++i ) {
+        window.push_back( i );
+    }
+#ifdef LARIAT_ALLOC_STATS
+    std::cout << "allocations in steady state = " << AllocStats::calls.load() << std::endl;
+#endif
+    for( int i = 5000; i < 100000; ++i ) {
+        d.push_back( i );
+        d.pop_front();
+    }
+    bool same = window.size() == d.size();
+    for( size_t i = 0; same && i < d.size(); ++i ) {
+        same = window[ i ] == d[ i ];
+    }
+    std::cout << "size = " << window.size() << " matches deque = " << same
+              << " capacity unchanged in steady state = " << ( window.capacity() == capacity ) << std::endl;
+    try {
+        window.insert( 500, -1 );
+    } catch( LariatException const& e ) {
+        std::cout << "insert(500) on a full window: " << e.what() << " size = " << window.size() << std::endl;
+    }
+    window.push_front( -2 ); // drops the last item, not the new one
+    std::cout << "after push_front: size = " << window.size() << " first = " << window.first()
+              << " last = " << window.last() << std::endl;
+    window.erase( 500 );
+    window.insert( 500, -1 );
+    std::cout << "after erase and insert: size = " << window.size() << " [500] = " << window[ 500 ] << std::endl;
+    window.set_max_size( 10 );
+    std::cout << "set_max_size(10): size = " << window.size() << " first = " << window.first()
+              << " last = " << window.last() << " capacity = " << window.capacity() << std::endl;
+
+    // load keeps the last max_size() items
+    Lariat<int, 64> all;
+    for( int i = 0; i < 1000; ++i ) {
+        all.push_back( i );
+    }
+    std::stringstream stream;
+    all.save( stream );
+    window.load( stream );
+    std::cout << "load: size = " << window.size() << " first = " << window.first()
+              << " last = " << window.last() << std::endl;
+
+    // 0 turns bounded mode off, emptied nodes are freed again instead of kept
+    window.set_max_size( 1000 );
+    for( int i = 0; i < 3000; ++i ) {
+        window.push_back( i );
+    }
+    window.set_max_size( 0 );
+    for( int i = 0; i < 900; ++i ) {
+        window.pop_front();
+    }
+    std::cout << "set_max_size(0) then 900 pop_front: size = " << window.size()
+              << " capacity = " << window.capacity() << std::endl;
+    for( int i = 0; i < 100; ++i ) {
+        window.push_back( i );
+    }
+    window.set_max_size( 100 );
+    window.shrink_to_fit();
+    std::cout << "shrink_to_fit: size = " << window.size() << " capacity = " << window.capacity() << std::endl;
+}
+
+
+void test47()
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    Lariat<char, 256> text;
+    std::string s;
+    const std::string words[] = { "lorem ", "ipsum ", "dolor ", "sit ", "amet, ", "consectetur\n" };
+    for( int i = 0; i < 20000; ++i ) {
+        const std::string &w = words[ i * 7 % 6 ];
+        size_t pos = static_cast<size_t>( i ) * 7919 % ( s.size() + 1 );
+        text.insert( pos, w );
+        s.insert( pos, w );
+    }
+    for( int i = 0; i < 2000; ++i ) {
+        size_t pos = static_cast<size_t>( i ) * 104729 % s.size();
+        size_t len = std::min<size_t>( static_cast<size_t>( i % 50 ), s.size() - pos );
+        text.erase( pos, len );
+        s.erase( pos, len );
+    }
+    bool same = text.size() == s.size() && text.substr( 0, text.size() ) == s;
+    for( size_t pos = 0; same && pos + 1000 < s.size(); pos += 4093 ) {
+        same = text.substr( pos, 1000 ) == s.substr( pos, 1000 );
+    }
+    std::cout << "edits match std::string = " << same << std::endl;
+    bool found = true;
+    const std::string needles[] = { "sit amet", "\nlorem", "dolor dolor", "consectetur\nconsectetur", "not there" };
+    for( const std::string &needle : needles ) {
+        size_t expected = s.find( needle );
+        found = found && text.find( needle ) == ( expected == std::string::npos ? text.size() : expected );
+    }
+    std::cout << "find matches std::string = " << found << std::endl;
+}
+
+
+void test48()
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    typedef Lariat<int, 100> List;
+    List lar;
+    std::vector<int> v;
+    for( int i = 0; i < 100000; ++i ) {
+        lar.push_back( i );
+        v.push_back( i );
+    }
+    for( int round = 0; round < 10; ++round ) {
+        // 300 inserts and up to 200 erases, indices relative to the list before the batch
+        std::vector<List::BatchOp> ops;
+        std::vector<bool> erased( v.size(), false );
+        std::vector<std::vector<int> > before( v.size() + 1 );
+        for( int i = 0; i < 500; ++i ) {
+            List::BatchOp op;
+            op.index = static_cast<size_t>( i + round ) * 7919 % v.size();
+            op.value = -i;
+            if ( i % 5 < 2 ) {
+                if ( erased[ op.index ] ) {
+                    continue;
+                }
+                op.kind = List::BatchOp::ERASE;
+                erased[ op.index ] = true;
+            }
+            else {
+                op.kind = List::BatchOp::INSERT;
+                before[ op.index ].push_back( op.value );
+            }
+            ops.push_back( op );
+        }
+        lar.apply_batch( ops );
+        std::vector<int> next;
+        for( size_t i = 0; i < v.size(); ++i ) {
+            next.insert( next.end(), before[ i ].begin(), before[ i ].end() );
+            if ( !erased[ i ] ) {
+                next.push_back( v[ i ] );
+            }
+        }
+        v.swap( next );
+    }
+    bool same = lar.size() == v.size();
+    for( size_t i = 0; same && i < v.size(); ++i ) {
+        same = lar[ i ] == v[ i ];
+    }
+    std::cout << "batches match vector = " << same << std::endl;
+    std::vector<List::BatchOp> bad( 2 );
+    bad[ 0 ].kind = bad[ 1 ].kind = List::BatchOp::ERASE;
+    bad[ 0 ].index = bad[ 1 ].index = 3;
+    try {
+        lar.apply_batch( bad );
+    }
+    catch ( const LariatException &e ) {
+        std::cout << "exception: " << e.what() << " size unchanged = " << ( lar.size() == v.size() ) << std::endl;
+    }
+}
+
+
+void test49()
+{
+    std::cout << "-------- " << __func__ << " --------\n";
+    // clustered data: readings that mostly rise, with a little jitter
+    Lariat<int, 128> plain, zoned;
+    zoned.enable_zone_maps<true, true>();
+    for( int i = 0; i < 200000; ++i ) {
+        int reading = i / 4 + ( i * 7 % 13 );
+        plain.push_back( reading );
+        zoned.push_back( reading );
+    }
+    for( int i = 0; i < 1000; ++i ) {
+        size_t pos = static_cast<size_t>( i ) * 7919 % zoned.size();
+        plain.insert( pos, -i );
+        zoned.insert( pos, -i );
+        plain.erase( pos / 2 );
+        zoned.erase( pos / 2 );
+    }
+    zoned.compact();
+    plain.compact();
+    std::cout << "find(30000) = " << zoned.find( 30000 ) << " same = " << ( zoned.find( 30000 ) == plain.find( 30000 ) ) << std::endl;
+    std::cout << "find(-500) = " << zoned.find( -500 ) << " same = " << ( zoned.find( -500 ) == plain.find( -500 ) ) << std::endl;
+    std::cout << "count(12345) = " << zoned.count( 12345 ) << " same = " << ( zoned.count( 12345 ) == plain.count( 12345 ) ) << std::endl;
+    std::cout << "count_range(1000, 1999) = " << zoned.count_range( 1000, 1999 )
+              << " same = " << ( zoned.count_range( 1000, 1999 ) == plain.count_range( 1000, 1999 ) ) << std::endl;
+    std::cout << "find_range(40000, 40010) = " << zoned.find_range( 40000, 40010 )
+              << " same = " << ( zoned.find_range( 40000, 40010 ) == plain.find_range( 40000, 40010 ) ) << std::endl;
+    std::cout << "find(10000000) = " << ( zoned.find( 10000000 ) == zoned.size() ) << std::endl;
+    zoned.transform( []( int x ) { return x * 2; } );
+    plain.transform( []( int x ) { return x * 2; } );
+    std::cout << "after transform count_range(2000, 3999) same = "
+              << ( zoned.count_range( 2000, 3999 ) == plain.count_range( 2000, 3999 ) ) << std::endl;
+
+    // query, mutate, compact, query again: nodes created after the first
+    // query have no summary yet when compact moves items into them
+    Lariat<int, 100> small;
+    small.enable_zone_maps<true, true>();
+    std::vector<int> v;
+    for( int i = 0; i < 300; ++i ) {
+        small.push_back( i );
+        v.push_back( i );
+    }
+    small.compact();
+    bool same = small.find( 20 ) == 20 && small.count( 20 ) == 1;
+    std::vector<Lariat<int, 100>::BatchOp> ops( 3 );
+    for( int i = 0; i < 3; ++i ) {
+        ops[ static_cast<size_t>( i ) ].kind = Lariat<int, 100>::BatchOp::INSERT;
+        ops[ static_cast<size_t>( i ) ].index = 0;
+        ops[ static_cast<size_t>( i ) ].value = -1 - i;
+        v.insert( v.begin() + i, -1 - i );
+    }
+    small.apply_batch( ops );
+    small.compact();
+    for( int q = -4; q < 310; ++q ) {
+        size_t expected = static_cast<size_t>( std::find( v.begin(), v.end(), q ) - v.begin() );
+        same = same && small.find( q ) == expected
+                    && small.count( q ) == static_cast<size_t>( std::count( v.begin(), v.end(), q ) );
+    }
+    small.rebalance( 0.5 );
+    small.insert( 150, 20 );
+    v.insert( v.begin() + 150, 20 );
+    same = same && small.count( 20 ) == 2 && small.find_range( 299, 299 ) == 303;
+    std::cout << "queries after apply_batch/compact/rebalance match vector = " << same << std::endl;
+}
+
 
 void (*pTests[])(void) = { 
 	test0, test1, test2, test3, test4, test5, test6, 
 	test7, test8, test9, test10, test11, test12, test13, 
 	test14, test15, test16, test17, test18, test19, test20,
-	test21, test22, test23, test24, test25, test26
+	test21, test22, test23, test24, test25, test26, test27, test28,
+	test29, test30, test31, test32, test33, test34,
+	test35, test36, test37, test38, test39,
+	test40, test41, test42, test43, test44, test45, test46, test47, test48, test49
 };
 
 void test_all() {
@@ -1113,7 +2565,72 @@ void test_all() {
 }
 
 #include <cstdio> /* sscanf */
+#include <fstream>
+#include <string>
+// picks the node size for replay_main, false if it isn't one of the four
+template < typename T >
+bool replay_typed( std::istream & trace, int nodesize, bool check )
+{
+    switch ( nodesize ) {
+        case 10:   replay_trace<T, 10>( trace, check );   return true;
+        case 100:  replay_trace<T, 100>( trace, check );  return true;
+        case 1000: replay_trace<T, 1000>( trace, check ); return true;
+        case 5000: replay_trace<T, 5000>( trace, check ); return true;
+    }
+    return false;
+}
+
+// gnu.exe replay <trace file> [node size 10|100|1000|5000, default 100]
+//                [element type int|longlong|double, default int] [check]
+// the optional arguments may come in any order and are told apart by value
+int replay_main( int argc, char *argv[] ) {
+    std::ifstream trace( argv[2], std::ios::binary );
+    if ( !trace ) {
+        std::cerr << "cannot open " << argv[2] << std::endl;
+        return 1;
+    }
+    int nodesize = 100;
+    std::string type = "int";
+    bool check = false;
+    for ( int arg = 3; arg < argc; ++arg ) {
+        std::string option = argv[arg];
+        if ( option == "check" ) {
+            check = true;
+        } else if ( std::sscanf( argv[arg], "%i", &nodesize ) != 1 ) {
+            type = option;
+        }
+    }
+    try {
+        bool known = true;
+        if ( type == "int" ) {
+            known = replay_typed<int>( trace, nodesize, check );
+        } else if ( type == "longlong" ) {
+            known = replay_typed<long long>( trace, nodesize, check );
+        } else if ( type == "double" ) {
+            known = replay_typed<double>( trace, nodesize, check );
+        } else {
+            std::cerr << "element type must be int, longlong or double" << std::endl;
+            return 1;
+        }
+        if ( !known ) {
+            std::cerr << "node size must be 10, 100, 1000 or 5000" << std::endl;
+            return 1;
+        }
+    } catch( LariatException const& e ) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
 int main(int argc, char *argv[] ) {
+    if (argc > 2 && std::string( argv[1] ) == "replay") {
+        return replay_main( argc, argv );
+    }
+    if (argc > 1 && std::string( argv[1] ) == "huge") {
+        test_huge();
+        return 0;
+    }
     if (argc >1) {
         int test = 0;
         std::sscanf(argv[1],"%i",&test);
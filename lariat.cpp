@@ -1,5 +1,16 @@
 #include <iostream>
 #include <iomanip>
+#include <cstdio>      // snprintf
+#include <locale>      // classic locale check in dump
+#include <cstdint>     // fixed width fields of the binary format
+#include <type_traits> // std::is_trivially_copyable
+#include <thread>      // bulk algorithm workers
+#include <vector>      // segment cut points
+#include <exception>   // std::exception_ptr
+#include <algorithm>   // std::sort, std::stable_sort, std::min
+#include <functional>  // std::less
+#include <unordered_map> // value index
+#include <bitset>      // popcount of dead slot bitmaps
 #include "lariat.h"
 
 #if 1
@@ -9,7 +20,12 @@
 
 // Constructor
 template<typename T, int Size>
-Lariat<T, Size>::Lariat() : head_(), tail_(), size_(0), nodecount_(0), asize_(Size)
+Lariat<T, Size>::Lariat() : head_(), tail_(), size_(0), nodecount_(0), asize_(Size),
+  spare_(), sparecount_(0), reserved_(0),
+  gapMode_(false), gapNode_(), gapIndex_(0), gapLength_(0),
+  lazyErase_(false), deadTotal_(0), maxSize_(0),
+  index_(), indexStale_(false), unindexed_(0),
+  zones_(), zoneStamp_(1), zonesPending_(false)
 {
   // This constructor is really simple. You don't need to do any logic, just
   // use a member initializer list to initialize
@@ -18,27 +34,68 @@ Lariat<T, Size>::Lariat() : head_(), tail_(), size_(0), nodecount_(0), asize_(Si
 // Copy Constructor (own-type)
 template<typename T, int Size>
 Lariat<T, Size>::Lariat(Lariat const & rhs)
+  : head_(), tail_(), size_(0), nodecount_(0), asize_(rhs.asize_),
+  spare_(), sparecount_(0), reserved_(rhs.reserved_),
+  gapMode_(rhs.gapMode_), gapNode_(), gapIndex_(rhs.gapIndex_), gapLength_(rhs.gapLength_),
+  lazyErase_(rhs.lazyErase_), deadTotal_(0), maxSize_(rhs.maxSize_),
+  index_(rhs.index_ ? rhs.index_->clone() : nullptr), indexStale_(rhs.index_ != nullptr), unindexed_(0),
+  zones_(rhs.zones_ ? rhs.zones_->clone() : nullptr), zoneStamp_(1), zonesPending_(rhs.zones_ != nullptr)
 {
-  // This is the standard copy constructor. The function should loop through the
-  // instance passed in, pushing each element of the other onto the back of
-  // the one being constructed.
-  // It should be done using the algorithm for (or directly calling) push_back
-  // so that all of the nodes are split correctly.
-  asize_ = rhs.asize_;
-  size_ = 0;
-  for (int i = 0; i < rhs.size_; i++)
+  // Copies of the same instantiation don't duplicate any elements. Each node
+  // of the copy gets its own links and count but points at the same storage
+  // block as the original, and whichever list writes to a shared block first
+  // clones it (see detach). rhs's inline node lives inside rhs, so its items
+  // are copied instead, and so are the items of exposed nodes: rhs may still
+  // hold a reference into their blocks and write through it later. Dead
+  // slot bitmaps belong to the nodes rather than the shared blocks, so each
+  // new node gets its own copy.
+  for (LNode *node = rhs.head_; node; node = node->next)
   {
-    push_back(rhs[i]);
+    LNode *newNode = rhs.inline_.owns(node) || node->exposed ? copyNode(node) : shareNode(node);
+    copyDead(newNode, node);
+    if (node == rhs.gapNode_)
+    {
+      gapNode_ = newNode;
+    }
+    newNode->prev = tail_;
+    if (tail_)
+    {
+      tail_->next = newNode;
+    }
+    else
+    {
+      head_ = newNode;
+    }
+    tail_ = newNode;
   }
+  size_ = rhs.size_;
+  fitSpares();
+}
+
+// Move Constructor
+template<typename T, int Size>
+Lariat<T, Size>::Lariat(Lariat && rhs) noexcept(std::is_nothrow_move_assignable<T>::value)
+  : head_(), tail_(), size_(0), nodecount_(0), asize_(Size),
+  spare_(), sparecount_(0), reserved_(0),
+  gapMode_(false), gapNode_(), gapIndex_(0), gapLength_(0),
+  lazyErase_(false), deadTotal_(0), maxSize_(0),
+  index_(), indexStale_(false), unindexed_(0),
+  zones_(), zoneStamp_(1), zonesPending_(false)
+{
+  steal(rhs);
 }
 
 template<typename T, int Size>
 template<typename L, int NewSize>
 Lariat<T, Size>::Lariat(const Lariat<L, NewSize> &rhs)
+  : head_(), tail_(), size_(0), nodecount_(0), asize_(Size),
+  spare_(), sparecount_(0), reserved_(0),
+  gapMode_(false), gapNode_(), gapIndex_(0), gapLength_(0),
+  lazyErase_(false), deadTotal_(0), maxSize_(0),
+  index_(), indexStale_(false), unindexed_(0),
+  zones_(), zoneStamp_(1), zonesPending_(false)
 {
-  asize_ = Size;
-  size_ = 0;
-  for (int i = 0; i < rhs.size_; i++)
+  for (size_t i = 0; i < rhs.size_; i++)
   {
     push_back(static_cast<T>(rhs[i]));
   }
@@ -50,26 +107,92 @@ Lariat<T, Size>::~Lariat()
 {
   // The destructor is a simple, generic destructor. It's sole purpose is to
   // free all the nodes in the linked list so there are no memory leaks.
+  delete index_;
+  reserved_ = 0;
+  maxSize_ = 0;
   while (nodecount_)
   {
     removeNode(head_);
   }
+  while (spare_)
+  {
+    LNode *next = spare_->next;
+    releaseBlock(spare_->block);
+    delete spare_;
+    spare_ = next;
+  }
+  delete zones_;
 }
 
 // operator= (own-type)
 template<typename T, int Size>
 Lariat<T, Size> & Lariat<T, Size>::operator=(const Lariat &rhs)
 {
+  if (this == &rhs)
+  {
+    return *this;
+  }
+  // Same as the copy constructor: drop our nodes and take over rhs's
+  // settings, then share rhs's storage blocks node by node.
   clear();
-  // This assignment operator generally works exactly the same as you might
-    // expect. Set the non-pointer members as necessary, clear this instance's
-    // data, then walk through the right-hand argument's list adding each
-    // element to this instance
   asize_ = rhs.asize_;
-  for (int i = 0; i < rhs.size_; i++)
+  gapMode_ = rhs.gapMode_;
+  gapIndex_ = rhs.gapIndex_;
+  gapLength_ = rhs.gapLength_;
+  lazyErase_ = rhs.lazyErase_;
+  maxSize_ = rhs.maxSize_;
+  reserved_ = rhs.reserved_;
+  delete index_;
+  index_ = rhs.index_ ? rhs.index_->clone() : nullptr;
+  indexStale_ = index_ != nullptr;
+  unindexed_ = 0;
+  disable_zone_maps();
+  zones_ = rhs.zones_ ? rhs.zones_->clone() : nullptr;
+  zoneStamp_ = 1;
+  zonesPending_ = zones_ != nullptr;
+  for (LNode *node = rhs.head_; node; node = node->next)
+  {
+    LNode *newNode = rhs.inline_.owns(node) || node->exposed ? copyNode(node) : shareNode(node);
+    copyDead(newNode, node);
+    if (node == rhs.gapNode_)
+    {
+      gapNode_ = newNode;
+    }
+    newNode->prev = tail_;
+    if (tail_)
+    {
+      tail_->next = newNode;
+    }
+    else
+    {
+      head_ = newNode;
+    }
+    tail_ = newNode;
+  }
+  size_ = rhs.size_;
+  fitSpares();
+
+  return *this;
+}
+
+// operator= (move)
+template<typename T, int Size>
+Lariat<T, Size> & Lariat<T, Size>::operator=(Lariat &&rhs) noexcept(std::is_nothrow_move_assignable<T>::value)
+{
+  if (this == &rhs)
   {
-    push_back(rhs[i]);
+    return *this;
   }
+  // As in the destructor, nothing is kept as a spare, so nothing is allocated.
+  reserved_ = 0;
+  maxSize_ = 0;
+  clear();
+  shrink_to_fit();
+  delete index_;
+  index_ = nullptr;
+  delete zones_;
+  zones_ = nullptr;
+  steal(rhs);
 
   return *this;
 }
@@ -84,7 +207,7 @@ Lariat<T, Size> &Lariat<T, Size>::operator=(const Lariat<L, NewSize> &rhs)
     // data, then walk through the right-hand argument's list adding each
     // element to this instance
   asize_ = Size;
-  for (int i = 0; i < rhs.size_; i++)
+  for (size_t i = 0; i < rhs.size_; i++)
   {
     push_back(static_cast<T>(rhs[i]));
   }
@@ -105,14 +228,15 @@ Lariat<T, Size> &Lariat<T, Size>::operator=(const Lariat<L, NewSize> &rhs)
 // Insert an element into the data structure at the index, between the element
 // at [index - 1] and the element at [index]
 template<typename T, int Size>
-void Lariat<T, Size>::insert(int index, const T & value)
+void Lariat<T, Size>::insert(size_t index, const T & value)
 {
   //std::cout << "Inserting " << value << " at index " << index << std::endl;
   
   // The first thing to this function is to check for an Out of Bounds error. If
     // the index is invalid, throw a LariatException with E_BAD_INDEX and the
     // description "Subscript is out of range"
-  if (index < 0 || index > size_)
+  // (index is unsigned, so a negative one has wrapped around past size_)
+  if (index > size_)
   {
     throw LariatException(LariatException::E_BAD_INDEX, "Subscript is out of range");
   }
@@ -135,12 +259,26 @@ void Lariat<T, Size>::insert(int index, const T & value)
     push_front(value);
     return;
   }
+  // A full bounded list only makes room at its ends.
+  if (maxSize_ && size_ >= maxSize_)
+  {
+    throw LariatException(LariatException::E_NO_MEMORY, "Lariat is at its maximum size");
+  }
 
   if (!head_)
   {
     head_ = makeNode();
     tail_ = head_;
   }
+  // In gap buffer mode a node with any free slot takes the item at its gap.
+  if (gapMode_ && currentNode->count < asize_ && newIndex < currentNode->count)
+  {
+    gapInsert(currentNode, newIndex, value);
+    indexAdd(currentNode, value);
+    zoneAdd(currentNode, value);
+    size_++;
+    return;
+  }
   // The next thing to do is to set up the actual insertion algorithm.
   // First, find the node and local index of the element being inserted. This
   // can be done with the findElement helper function detailed in the
@@ -175,8 +313,9 @@ void Lariat<T, Size>::insert(int index, const T & value)
       newIndex -= currentNode->count + 1;
       currentNode->count++;
       currentNode = currentNode->next;
-      currentNode->count--;
+      indexMove(currentNode, currentNode->prev, currentNode->values[0]);
       shiftDown(currentNode);
+      currentNode->count--;
     }
   }
 
@@ -212,6 +351,8 @@ void Lariat<T, Size>::insert(int index, const T & value)
   }
 
   currentNode->values[newIndex] = value;
+  indexAdd(currentNode, value);
+  zoneAdd(currentNode, value);
   size_++;
 }
 
@@ -219,7 +360,12 @@ void Lariat<T, Size>::insert(int index, const T & value)
 template<typename T, int Size>
 void Lariat<T, Size>::push_back(const T & value)
 {
-  
+  // In bounded mode the oldest item goes first, so an emptied head node is
+  // already a spare by the time the tail needs a new node.
+  if (maxSize_ && size_ == maxSize_)
+  {
+    pop_front();
+  }
   if (!head_)
   {
     head_ = makeNode();
@@ -227,13 +373,23 @@ void Lariat<T, Size>::push_back(const T & value)
   }
   // This is an easy algorithm using the split function.
   // If the tail node is full, split the node and update the tail_ pointer.
-  if (tail_->count == asize_)
+  // A bounded list only grows at the back, so it starts a new node instead
+  // and keeps every node but the tail full.
+  if (tail_->count == asize_ && maxSize_)
+  {
+    appendNode();
+  }
+  else if (tail_->count == asize_)
   {
     split(tail_, SplitType::TOPHEAVY);
     tail_ = tail_->next;
   }
-  // Set the last element in the tail's array to the value.
+  // Set the last element in the tail's array to the value. Opening the slot
+  // with shiftUp moves nothing, it only makes sure there is room at the back.
+  shiftUp(tail_, tail_->count);
   tail_->values[tail_->count] = value;
+  indexAdd(tail_, value);
+  zoneAdd(tail_, value);
   // Increment the tail node's count.
   tail_->count++;
 
@@ -244,6 +400,11 @@ void Lariat<T, Size>::push_back(const T & value)
 template<typename T, int Size>
 void Lariat<T, Size>::push_front(const T & value)
 {
+  // In bounded mode the item at the other end goes, as for push_back.
+  if (maxSize_ && size_ == maxSize_)
+  {
+    pop_back();
+  }
   if (!head_)
   {
     head_ = makeNode();
@@ -274,6 +435,8 @@ void Lariat<T, Size>::push_front(const T & value)
 
   // Set the 0'th element of the head to the value.
   head_->values[0] = value;
+  indexAdd(head_, value);
+  zoneAdd(head_, value);
   head_->count++;
 
   size_++;
@@ -285,8 +448,12 @@ void Lariat<T, Size>::push_front(const T & value)
 
 // erase
 template<typename T, int Size>
-void Lariat<T, Size>::erase(int index)
+void Lariat<T, Size>::erase(size_t index)
 {
+  if (index >= size_)
+  {
+    throw LariatException(LariatException::E_BAD_INDEX, "Subscript is out of range");
+  }
   // This function uses the findElement helper function I have detailed in the
     // Recommended Helper Functions section of this guide. Having implemented
     // that, the function itself is relatively simple.
@@ -307,14 +474,32 @@ void Lariat<T, Size>::erase(int index)
   // First, find the containing node and local index of the requested global
     // index.
   IndexedNode iNode = findElement(index);
-  // Shift all the elements in the node beyond the local index left one element,
-    // covering the element being erased. This is done with the shiftDown
-    // function detailed in the Recommended Helper Functions section. Make sure
-    // to account for the node being only one element large.
-  shiftDown(iNode.node, iNode.index);
-  // Decrement the node's count.
-  iNode.node->count--;
+  indexRemove(iNode.node, iNode.node->values[slot(iNode.node, iNode.index)]);
+  if (gapMode_)
+  {
+    gapErase(iNode.node, iNode.index);
+  }
+  else if (lazyErase_)
+  {
+    lazyErase(iNode.node, iNode.index);
+  }
+  else
+  {
+    // Shift all the elements in the node beyond the local index left one element,
+      // covering the element being erased. This is done with the shiftDown
+      // function detailed in the Recommended Helper Functions section. Make sure
+      // to account for the node being only one element large.
+    shiftDown(iNode.node, iNode.index);
+    // Decrement the node's count.
+    iNode.node->count--;
+  }
   size_--;
+  // Like the pops, don't leave an empty node behind; pop_front and pop_back
+    // expect the end nodes to hold at least one item.
+  if (iNode.node->count == 0)
+  {
+    removeNode(iNode.node);
+  }
 }
 
 // pop_back
@@ -322,6 +507,12 @@ template<typename T, int Size>
 void Lariat<T, Size>::pop_back()
 {
   // Decrement the count of the tail node.
+  if (tail_ == gapNode_)
+  {
+    closeGap();
+  }
+  settleNode(tail_);
+  indexRemove(tail_, tail_->values[tail_->count - 1]);
   tail_->count--;
   size_--;
   if (tail_->count == 0)
@@ -334,6 +525,7 @@ void Lariat<T, Size>::pop_back()
 template<typename T, int Size>
 void Lariat<T, Size>::pop_front()
 {
+  indexRemove(head_, head_->values[slot(head_, 0)]);
   // Shift all elements in the head node down one element.
   shiftDown(head_);
   // Decrement the head's count.
@@ -352,20 +544,25 @@ void Lariat<T, Size>::pop_front()
 
 // operator[]
 template<typename T, int Size>
-T & Lariat<T, Size>::operator[](int index)
+T & Lariat<T, Size>::operator[](size_t index)
 {
   // Find the containing node and local index of the index passed in. Like
     // insert and erase, this is easily done with the findElement helper
     // function I detailed in the Recommended Helper Functions section of this
     // guide.
   IndexedNode iNode = findElement(index);
+  // The caller may write through the reference, so the node can't stay shared
+  // and neither its index entries nor its summary can be trusted any more.
+  expose(iNode.node);
+  indexForget(iNode.node);
+  zoneDirty(iNode.node);
 
   // Return the element at the local index of the containing node.
-  return iNode.node->values[iNode.index];
+  return iNode.node->values[slot(iNode.node, iNode.index)];
 }
 
 template<typename T, int Size>
-const T & Lariat<T, Size>::operator[](int index) const
+const T & Lariat<T, Size>::operator[](size_t index) const
 {
   // Find the containing node and local index of the index passed in. Like
     // insert and erase, this is easily done with the findElement helper
@@ -374,7 +571,7 @@ const T & Lariat<T, Size>::operator[](int index) const
   IndexedNode iNode = findElement(index);
 
   // Return the element at the local index of the containing node.
-  return iNode.node->values[iNode.index];
+  return iNode.node->values[slot(iNode.node, iNode.index)];
 }
 
 // first
@@ -383,14 +580,16 @@ T & Lariat<T, Size>::first()
 {
   // This is one of the easiest functions in this assignment.
   // Return the first element of the head node.
-
-  // TODO: insert return statement here
+  expose(head_);
+  indexForget(head_);
+  zoneDirty(head_);
+  return head_->values[slot(head_, 0)];
 }
 
 template<typename T, int Size>
 T const & Lariat<T, Size>::first() const
 {
-  // TODO: insert return statement here
+  return head_->values[slot(head_, 0)];
 }
 
 // last
@@ -399,332 +598,2793 @@ T & Lariat<T, Size>::last()
 {
   // This is also an easy function.
   // Return the last element in the tail node.
-
-  // TODO: insert return statement here
+  expose(tail_);
+  indexForget(tail_);
+  zoneDirty(tail_);
+  return tail_->values[slot(tail_, tail_->count - 1)];
 }
 
 template<typename T, int Size>
 T const & Lariat<T, Size>::last() const
 {
-  // TODO: insert return statement here
+  return tail_->values[slot(tail_, tail_->count - 1)];
 }
 
 /*******************************************************************************
-========================== Data Structure Information ==========================
+================================= Text Editing =================================
 *******************************************************************************/
 
-// find
+// insert (text)
+// The items behind the insertion point are set aside, then the text and those
+// items are copied in node-sized runs, filling the node and then new nodes
+// linked after it
 template<typename T, int Size>
-unsigned Lariat<T, Size>::find(const T & value) const
+template<typename C>
+void Lariat<T, Size>::insert(size_t index, const C *text, size_t length)
 {
-  // Walk the list in a similar fashion to that detailed in the findElement
-    // helper function, but check equivalence for each element in each node,
-    // returning the index when the desired element is found.
-  LNode *node = head_;
-  for (unsigned globalIndex = 0; globalIndex < unsigned(size_); )
+  static_assert(std::is_same<C, char>::value, "text operations need Lariat<char, Size>");
+  if (index > size_)
   {
-    for (int i = 0; i < node->count; i++)
-    {
-      if (node->values[i] == value)
-      {
-        return globalIndex;
-      }
-      globalIndex++;
-    }
-    node = node->next;
+    throw LariatException(LariatException::E_BAD_INDEX, "Subscript is out of range");
   }
-  // If the desired element is not found, return the total number of elements
-    // contained in the data structure.
-  return size_;
+  if (!length)
+  {
+    return;
+  }
+  if (maxSize_ && length > maxSize_ - size_)
+  {
+    throw LariatException(LariatException::E_NO_MEMORY, "Lariat is at its maximum size");
+  }
+  LNode *node = tail_;
+  int offset = tail_ ? tail_->count : 0;
+  if (!head_)
+  {
+    node = appendNode();
+  }
+  else if (index < size_)
+  {
+    IndexedNode indexedNode = findElement(index);
+    node = indexedNode.node;
+    offset = indexedNode.index;
+  }
+  if (node == gapNode_)
+  {
+    closeGap();
+  }
+  // slide settles and unshares the node and starts the items at values[0],
+  // so the whole block is free behind them
+  slide(node, 0);
+  std::basic_string<C> back(node->values + offset, static_cast<size_t>(node->count - offset));
+  node->count = offset;
+  node = fillText(node, text, length);
+  fillText(node, back.data(), back.size());
+  size_ += length;
+  markIndexStale();
 }
 
-// size
 template<typename T, int Size>
-size_t Lariat<T, Size>::size(void) const
+template<typename C>
+void Lariat<T, Size>::insert(size_t index, const std::basic_string<C> &text)
 {
-  // You should be tracking the size_ member variable throughout the element
-    // addition and removal processes. Return that variable now.
-  return size_;
+  insert(index, text.data(), text.size());
 }
 
-/*******************************************************************************
-============================ Data Structure Control ============================
-*******************************************************************************/
-
-// clear
+// erase (range)
+// Whole nodes in the range are unlinked, a range starting at the front of a
+// node only moves the node's first item pointer, and only the node the range
+// starts in can need its items moved down
 template<typename T, int Size>
-void Lariat<T, Size>::clear(void)
+void Lariat<T, Size>::erase(size_t index, size_t length)
 {
-  // This is a relatively simple function with a similar algorithm to the
-    // class destructor.
-  // First, loop through the list, freeing each node in turn.
-  // Once the list is empty, update the necessary member variables.
-  while (head_)
+  if (index > size_ || length > size_ - index)
   {
-    removeNode(head_);
+    throw LariatException(LariatException::E_BAD_INDEX, "Subscript is out of range");
   }
-  size_ = 0;
-}
-
-// compact
-template<typename T, int Size>
-void Lariat<T, Size>::compact()
-{
-  //std::cout << "Node Count: " << nodecount_ << std::endl;
-
-  // Compact takes all the data stored in the linked list and moves it into the
-    // smallest number of nodes possible. Then it frees all empty nodes at the
-    // end of the list.
-  if (nodecount_ == 1 || head_ == nullptr)
+  if (!length)
   {
-    //std::cout << "Nothing happened" << std::endl;
     return;
   }
-  // The algorithm for this walks the list at two points in parallel. I will
-    // refer to the walker having elements shifted into it as the left foot and
-    // the walker reading through the elements to shift as the right foot.
-  LNode *leftFoot = head_;
-  LNode *rightFoot = head_->next;
-  // First, loop through the list with both feet until the left node is not
-    // already full and the right foot hasn't walked off the list.
-  while (rightFoot)
+  closeGap();
+  IndexedNode indexedNode = findElement(index);
+  LNode *node = indexedNode.node;
+  int offset = indexedNode.index;
+  size_ -= length;
+  while (length)
   {
-    if (leftFoot->count != asize_)
+    LNode *next = node->next;
+    settleNode(node);
+    int run = static_cast<size_t>(node->count - offset) < length ? node->count - offset
+                                                                 : static_cast<int>(length);
+    if (run == node->count)
     {
-      break;
+      removeNode(node);
     }
-    leftFoot = leftFoot->next;
-    rightFoot = rightFoot->next;
-  }
-  // Next, walk through the list while the right foot hasn't lost the list.
-    // This loop should first store the count of elements in the right node,
-      // then set the count of the right node to zero. This allows the left foot
-      // to update it as it is given elements to store.
-  //std::cout << *this << std::endl;
-  while (rightFoot)
-  {
-    int savedCount = leftFoot->count;
-    for (int i = savedCount; i < asize_; i++)
-    {
-      if (rightFoot->count != 0)
-      { 
-        leftFoot->values[i] = rightFoot->values[0];
-        leftFoot->count++;
-        rightFoot->count--;
-        shiftDown(rightFoot, 0);
-      }
-      if(rightFoot->count == 0)
-      {
-        LNode *temp = rightFoot->prev;
-        removeNode(rightFoot);
-        if (!temp->next)
-        {
-          tail_ = temp;
-          return;
-        }
-        rightFoot = temp->next;
-        break;
-      }
+    else if (offset == 0)
+    {
+      node->values += run;
+      node->count -= run;
     }
-    if (leftFoot->count == asize_)
+    else
     {
-      leftFoot = leftFoot->next;
-      rightFoot = rightFoot->next;
+      detach(node);
+      for (int i = offset; i + run < node->count; i++)
+      {
+        node->values[i] = node->values[i + run];
+      }
+      node->count -= run;
     }
+    length -= static_cast<size_t>(run);
+    offset = 0;
+    node = next;
   }
+  markIndexStale();
+}
 
-  if (!leftFoot->next)
+// substr
+template<typename T, int Size>
+template<typename C>
+std::basic_string<C> Lariat<T, Size>::substr(size_t index, size_t length) const
+{
+  static_assert(std::is_same<C, char>::value, "text operations need Lariat<char, Size>");
+  if (index > size_ || length > size_ - index)
   {
-    tail_ = leftFoot;
+    throw LariatException(LariatException::E_BAD_INDEX, "Subscript is out of range");
   }
-  else
+  std::basic_string<C> text;
+  if (!length)
   {
-    findTail(leftFoot);
+    return text;
   }
-
-    // This loop should have a nested loop that stores each value from the right
-      // foot in the left foot's node, and steps the left foot to the next node
-      // when it is filled.
-  //...Diagram.  See handout
-
-      // Once the deque has been compacted, remove all the extra nodes from the
-      // end of the list.
+  text.reserve(length);
+  IndexedNode indexedNode = findElement(index);
+  LNode *node = indexedNode.node;
+  int offset = indexedNode.index;
+  while (length)
+  {
+    if (offset == node->count)
+    {
+      node = node->next;
+      offset = 0;
+      continue;
+    }
+    int run = contiguous(node, offset);
+    size_t copied = static_cast<size_t>(run) < length ? static_cast<size_t>(run) : length;
+    text.append(&node->values[slot(node, offset)], copied);
+    offset += static_cast<int>(copied);
+    length -= copied;
+  }
+  return text;
 }
 
-// split
+// find (text)
+// memchr finds candidates for the first character within each contiguous
+// run, the rest of the text is then compared run by run (matchText), so a
+// match may cross any number of node boundaries
 template<typename T, int Size>
-void Lariat<T, Size>::split(LNode * node, SplitType type)
+template<typename C>
+size_t Lariat<T, Size>::find(const C *text, size_t length) const
 {
-  // This helper function takes a full node and splits into two nodes of an
-  // aproximately equivalent number of elements.
-  // First, create a new node to split the original node into.
-  // Calculate the index from which to move elements over from. This should
-  // account for an element being appended to the second node after the
-  // function has been called. If you're implementing this with overflow,
-  // you should have already worked out how the overflow gets assigned its
-  // position.
-  // Loop through the elements from the index in the first node, transferring
-  // them each to the newly added node. Update the added node's count during
-  // the loop.
-      //...See handout for diagram
-
-  // Set the count of the original node to index, and insert the added node
-  // immediately after the original node.
-  LNode *newNode = makeNode();
-  LNode *oldNext = nullptr;
-  if (node->next)
+  static_assert(std::is_same<C, char>::value, "text operations need Lariat<char, Size>");
+  if (!length)
   {
-    oldNext = node->next;
-    oldNext->prev = newNode;
+    return 0;
   }
-  newNode->next = node->next;
-  newNode->prev = node;
-  node->next = newNode;
-
-  int newNodeCount;
-  if (asize_ % 2)
+  if (length > size_)
   {
-    if (type == SplitType::TOPHEAVY)
+    return size_;
+  }
+  size_t base = 0; // list index of the node's first item
+  for (LNode *node = head_; node; base += static_cast<size_t>(node->count), node = node->next)
+  {
+    int offset = 0;
+    while (offset < node->count)
     {
-      newNodeCount = (asize_ / 2) + 1;
-      newNode->count = newNodeCount - 1;
+      int run = contiguous(node, offset);
+      const C *data = &node->values[slot(node, offset)];
+      const C *hit = static_cast<const C *>(std::memchr(data, text[0], static_cast<size_t>(run)));
+      if (!hit)
+      {
+        offset += run;
+        continue;
+      }
+      offset += static_cast<int>(hit - data);
+      if (base + static_cast<size_t>(offset) + length > size_)
+      {
+        return size_;
+      }
+      if (matchText(node, offset, text, length))
+      {
+        return base + static_cast<size_t>(offset);
+      }
+      offset++;
     }
-    else
+  }
+  return size_;
+}
+
+template<typename T, int Size>
+template<typename C>
+size_t Lariat<T, Size>::find(const std::basic_string<C> &text) const
+{
+  return find(text.data(), text.size());
+}
+
+// fillText
+// Appends length items behind the last one in node, linking in new nodes as
+// each fills up; returns the node holding the last item
+template<typename T, int Size>
+template<typename C>
+typename Lariat<T, Size>::LNode * Lariat<T, Size>::fillText(LNode *node, const C *text, size_t length)
+{
+  zoneDirty(node);
+  while (length)
+  {
+    if (node->count == asize_)
     {
-      newNodeCount = (asize_ / 2);
-      newNode->count = newNodeCount + 1;
+      node = linkAfter(node);
     }
+    size_t run = static_cast<size_t>(asize_ - node->count) < length ? static_cast<size_t>(asize_ - node->count)
+                                                                    : length;
+    std::memcpy(node->values + node->count, text, run);
+    node->count += static_cast<int>(run);
+    text += run;
+    length -= run;
   }
-  else
+  return node;
+}
+
+// matchText
+template<typename T, int Size>
+template<typename C>
+bool Lariat<T, Size>::matchText(const LNode *node, int offset, const C *text, size_t length) const
+{
+  while (length)
   {
-    if (type == SplitType::TOPHEAVY)
+    if (offset == node->count)
     {
-      newNodeCount = (asize_ / 2) + 1;
-      newNode->count = newNodeCount - 2;
+      node = node->next;
+      offset = 0;
+      continue;
     }
-    else
+    int run = contiguous(node, offset);
+    size_t compared = static_cast<size_t>(run) < length ? static_cast<size_t>(run) : length;
+    if (std::memcmp(&node->values[slot(node, offset)], text, compared) != 0)
     {
-      newNodeCount = asize_ / 2;
-      newNode->count = newNodeCount;
+      return false;
     }
+    offset += static_cast<int>(compared);
+    text += compared;
+    length -= compared;
   }
-
-  for (int i = 0; i < asize_ - newNodeCount; i++)
-  {
-    newNode->values[i] = node->values[newNodeCount + i];
-  }
-
-  node->count = newNodeCount;
+  return true;
 }
 
-// findElement
+/*******************************************************************************
+================================ Batched Edits =================================
+*******************************************************************************/
+
+// apply_batch
+// Walks the list once, keeping the list index of each node's first item. A
+// node with ops in its range has its new items gathered in front of it and
+// written back from the start of its block, spilling into new nodes linked
+// after it when they don't fit; nodes without ops are only counted.
 template<typename T, int Size>
-typename Lariat<T, Size>::IndexedNode Lariat<T, Size>::findElement(int index) const
+void Lariat<T, Size>::apply_batch(const std::vector<BatchOp> &ops)
 {
-  // This function takes a global index to find in the deque and must return
-  // both a pointer to the node in the list and the local index of the element
-  // in the returned node.
-  // Clearly returning multiple variables is a *small* challenge in C and C++,
-  // so you will have to find a way to work around that.
-  // The algorithm for this function is focused around looping through the list
-  // and tracking the total number of elements stored before the current
-  // node. I used a counter and added each node's count until I passed the
-  // desired global index.
-  // Because each node in the list only stores the number of elements it is
-  // using actively, the count of each has to be added individually to keep an
-  // accurate count of the number of elements that have been stepped over.
-  if (!head_)
+  std::vector<const BatchOp *> order;
+  order.reserve(ops.size());
+  size_t inserts = 0;
+  for (const BatchOp &op : ops)
   {
-    IndexedNode nullNode; 
-    nullNode.node = nullptr;
-    nullNode.index = 0;
-    return nullNode;
+    if (op.index > size_ || (op.kind == BatchOp::ERASE && op.index == size_))
+    {
+      throw LariatException(LariatException::E_BAD_INDEX, "Subscript is out of range");
+    }
+    inserts += op.kind == BatchOp::INSERT;
+    order.push_back(&op);
   }
-
-  if (index < head_->count)
+  if (maxSize_ && size_ + inserts > maxSize_ + (ops.size() - inserts))
   {
-    IndexedNode onlyNode;
-    onlyNode.node = head_;
-    onlyNode.index = index;
-    return onlyNode;
+    throw LariatException(LariatException::E_NO_MEMORY, "Lariat is at its maximum size");
   }
-
-  int newIndex = index;
-  LNode *node = head_;
-  while (node->next)
+  // Inserts at an index go in front of the item there, so they sort before
+  // an erase of that item.
+  std::stable_sort(order.begin(), order.end(), [](const BatchOp *a, const BatchOp *b) {
+    return a->index < b->index || (a->index == b->index && a->kind == BatchOp::INSERT && b->kind == BatchOp::ERASE);
+  });
+  for (size_t i = 1; i < order.size(); i++)
   {
-    newIndex -= node->count;
+    if (order[i]->kind == BatchOp::ERASE && order[i - 1]->kind == BatchOp::ERASE &&
+        order[i]->index == order[i - 1]->index)
+    {
+      throw LariatException(LariatException::E_BAD_INDEX, "Item erased twice in one batch");
+    }
+  }
+  if (order.empty())
+  {
+    return;
+  }
+
+  closeGap();
+  settle();
+  markIndexStale();
+  if (!head_)
+  {
+    appendNode();
+  }
+  std::vector<T> items;
+  size_t base = 0; // list index of node's first item, before the batch
+  size_t next = 0; // first op not applied yet
+  LNode *node = head_;
+  while (node && next < order.size())
+  {
+    LNode *following = node->next;
+    size_t end = base + static_cast<size_t>(node->count);
+    // The last node also takes the inserts at the end of the list.
+    if (order[next]->index >= end && (following || order[next]->index > end))
+    {
+      base = end;
+      node = following;
+      continue;
+    }
+    items.clear();
+    size_t kept = 0; // items of the node already looked at
+    for (; next < order.size() && (order[next]->index < end || !following); next++)
+    {
+      const BatchOp &op = *order[next];
+      for (; base + kept < op.index; kept++)
+      {
+        items.push_back(node->values[kept]);
+      }
+      if (op.kind == BatchOp::INSERT)
+      {
+        items.push_back(op.value);
+        size_++;
+      }
+      else
+      {
+        kept++;
+        size_--;
+      }
+    }
+    for (; kept < static_cast<size_t>(node->count); kept++)
+    {
+      items.push_back(node->values[kept]);
+    }
+    base = end;
+    if (items.empty())
+    {
+      removeNode(node);
+      node = following;
+      continue;
+    }
+    detach(node);
+    zoneDirty(node);
+    node->values = node->block->values;
+    node->count = 0;
+    for (size_t i = 0; i < items.size(); i++)
+    {
+      if (node->count == asize_)
+      {
+        node = linkAfter(node);
+      }
+      node->values[node->count++] = items[i];
+    }
+    node = following;
+  }
+}
+
+/*******************************************************************************
+================================== Zone Maps ===================================
+*******************************************************************************/
+
+// Like the index, the summary's layout depends on what enable_zone_maps was
+// asked for, so the list only holds LZone pointers and works on them through
+// this interface. A summary is never narrower than the items of its node;
+// one whose stamp isn't zoneStamp_ is rebuilt from the items before use.
+template<typename T, int Size>
+struct Lariat<T, Size>::LZone
+{
+  unsigned long stamp = 0;
+  bool          empty = true;
+  uint64_t      bloom = 0;
+};
+
+template<typename T, int Size>
+struct Lariat<T, Size>::LZoneMap
+{
+  virtual ~LZoneMap() {}
+  virtual LZoneMap *clone() const = 0;
+  virtual LZone *make() const = 0;
+  virtual void destroy(LZone *zone) const = 0;
+  virtual void reset(LZone *zone) const = 0;
+  virtual void add(LZone *zone, const T &value) const = 0;
+  virtual void merge(LZone *zone, const LZone *from) const = 0;
+  virtual bool mayHold(const LZone *zone, const T &value) const = 0;
+  virtual bool mayHold(const LZone *zone, const T &low, const T &high) const = 0;
+  virtual bool holdsOnly(const LZone *zone, const T &low, const T &high) const = 0;
+};
+
+// The min/max and bloom parts are picked by tag dispatch, so T only needs
+// operator< or a hash when that part is asked for.
+template<typename T, int Size>
+template<bool MinMax, bool Bloom, typename Hash>
+struct Lariat<T, Size>::LZoneMapImpl : LZoneMap
+{
+  typedef std::integral_constant<bool, MinMax> HasRange;
+  typedef std::integral_constant<bool, Bloom>  HasBloom;
+
+  struct Summary : LZone
+  {
+    T min;
+    T max;
+  };
+
+  LZoneMap *clone() const { return new LZoneMapImpl(*this); }
+  LZone *make() const { return new Summary(); }
+  void destroy(LZone *zone) const { delete static_cast<Summary *>(zone); }
+  void reset(LZone *zone) const
+  {
+    zone->empty = true;
+    zone->bloom = 0;
+  }
+  void add(LZone *zone, const T &value) const
+  {
+    Summary *summary = static_cast<Summary *>(zone);
+    widen(summary, value, value, HasRange());
+    summary->bloom |= bits(value, HasBloom());
+    summary->empty = false;
+  }
+  void merge(LZone *zone, const LZone *from) const
+  {
+    if (from->empty)
+    {
+      return;
+    }
+    Summary *summary = static_cast<Summary *>(zone);
+    const Summary *other = static_cast<const Summary *>(from);
+    widen(summary, other->min, other->max, HasRange());
+    summary->bloom |= other->bloom;
+    summary->empty = false;
+  }
+  bool mayHold(const LZone *zone, const T &value) const
+  {
+    if (zone->empty)
+    {
+      return false;
+    }
+    uint64_t mask = bits(value, HasBloom());
+    return (zone->bloom & mask) == mask && overlaps(static_cast<const Summary *>(zone), value, value, HasRange());
+  }
+  bool mayHold(const LZone *zone, const T &low, const T &high) const
+  {
+    return !zone->empty && overlaps(static_cast<const Summary *>(zone), low, high, HasRange());
+  }
+  bool holdsOnly(const LZone *zone, const T &low, const T &high) const
+  {
+    return !zone->empty && within(static_cast<const Summary *>(zone), low, high, HasRange());
+  }
+
+  static void widen(Summary *summary, const T &low, const T &high, std::true_type)
+  {
+    if (summary->empty || low < summary->min)
+    {
+      summary->min = low;
+    }
+    if (summary->empty || summary->max < high)
+    {
+      summary->max = high;
+    }
+  }
+  static void widen(Summary *, const T &, const T &, std::false_type) {}
+  static bool overlaps(const Summary *summary, const T &low, const T &high, std::true_type)
+  {
+    return !(high < summary->min) && !(summary->max < low);
+  }
+  static bool overlaps(const Summary *, const T &, const T &, std::false_type) { return true; }
+  static bool within(const Summary *summary, const T &low, const T &high, std::true_type)
+  {
+    return !(summary->min < low) && !(high < summary->max);
+  }
+  static bool within(const Summary *, const T &, const T &, std::false_type) { return false; }
+  // two bits out of 64, both taken from one multiplicative hash of the value
+  static uint64_t bits(const T &value, std::true_type)
+  {
+    uint64_t x = static_cast<uint64_t>(Hash()(value)) * 0x9E3779B97F4A7C15ull;
+    return (uint64_t(1) << (x >> 58)) | (uint64_t(1) << ((x >> 52) & 63));
+  }
+  static uint64_t bits(const T &, std::false_type) { return 0; }
+};
+
+// enable_zone_maps
+template<typename T, int Size>
+template<bool MinMax, bool Bloom, typename Hash>
+void Lariat<T, Size>::enable_zone_maps()
+{
+  disable_zone_maps();
+  zones_ = new LZoneMapImpl<MinMax, Bloom, Hash>();
+  zonesPending_ = true;
+}
+
+// disable_zone_maps
+template<typename T, int Size>
+void Lariat<T, Size>::disable_zone_maps()
+{
+  if (!zones_)
+  {
+    return;
+  }
+  for (LNode *node = head_; node; node = node->next)
+  {
+    if (node->zone)
+    {
+      zones_->destroy(node->zone);
+      node->zone = nullptr;
+    }
+  }
+  delete zones_;
+  zones_ = nullptr;
+}
+
+// zone_mapped
+template<typename T, int Size>
+bool Lariat<T, Size>::zone_mapped() const
+{
+  return zones_ != nullptr;
+}
+
+// count
+template<typename T, int Size>
+size_t Lariat<T, Size>::count(const T & value) const
+{
+  // The index already knows how often the value is in each node, only the
+  // nodes taken out of it are counted here.
+  if (index_ && !indexStale_)
+  {
+    const typename LIndex::Postings *postings = index_->lookup(value);
+    size_t total = 0;
+    for (size_t i = 0; postings && i < postings->size(); i++)
+    {
+      total += static_cast<size_t>((*postings)[i].second);
+    }
+    for (LNode *node = head_; node && unindexed_; node = node->next)
+    {
+      for (int i = 0; node->unindexed && i < node->count; i++)
+      {
+        total += node->values[slot(node, i)] == value;
+      }
+    }
+    return total;
+  }
+  size_t total = 0;
+  for (LNode *node = head_; node; node = node->next)
+  {
+    const LZone *zone = zoneOf(node);
+    if (zone && !zones_->mayHold(zone, value))
+    {
+      continue;
+    }
+    for (int i = 0; i < node->count; i++)
+    {
+      if (node->values[slot(node, i)] == value)
+      {
+        total++;
+      }
+    }
+  }
+  return total;
+}
+
+template<typename T, int Size>
+size_t Lariat<T, Size>::count(const T & value)
+{
+  prepareQuery();
+  return static_cast<const Lariat &>(*this).count(value);
+}
+
+// count_range
+// A node whose summary lies inside the range is counted without looking at it
+template<typename T, int Size>
+size_t Lariat<T, Size>::count_range(const T & low, const T & high) const
+{
+  size_t total = 0;
+  for (LNode *node = head_; node; node = node->next)
+  {
+    const LZone *zone = zoneOf(node);
+    if (zone)
+    {
+      if (!zones_->mayHold(zone, low, high))
+      {
+        continue;
+      }
+      if (zones_->holdsOnly(zone, low, high))
+      {
+        total += static_cast<size_t>(node->count);
+        continue;
+      }
+    }
+    for (int i = 0; i < node->count; i++)
+    {
+      const T &value = node->values[slot(node, i)];
+      if (!(value < low) && !(high < value))
+      {
+        total++;
+      }
+    }
+  }
+  return total;
+}
+
+template<typename T, int Size>
+size_t Lariat<T, Size>::count_range(const T & low, const T & high)
+{
+  prepareQuery();
+  return static_cast<const Lariat &>(*this).count_range(low, high);
+}
+
+// find_range
+template<typename T, int Size>
+size_t Lariat<T, Size>::find_range(const T & low, const T & high) const
+{
+  size_t globalIndex = 0;
+  for (LNode *node = head_; node; node = node->next)
+  {
+    const LZone *zone = zoneOf(node);
+    if (!zone || zones_->mayHold(zone, low, high))
+    {
+      for (int i = 0; i < node->count; i++)
+      {
+        const T &value = node->values[slot(node, i)];
+        if (!(value < low) && !(high < value))
+        {
+          return globalIndex + static_cast<size_t>(i);
+        }
+      }
+    }
+    globalIndex += static_cast<size_t>(node->count);
+  }
+  return size_;
+}
+
+template<typename T, int Size>
+size_t Lariat<T, Size>::find_range(const T & low, const T & high)
+{
+  prepareQuery();
+  return static_cast<const Lariat &>(*this).find_range(low, high);
+}
+
+template<typename T, int Size>
+void Lariat<T, Size>::zoneAdd(LNode *node, const T & value)
+{
+  if (zones_ && node->zone && node->zone->stamp == zoneStamp_)
+  {
+    zones_->add(node->zone, value);
+  }
+}
+
+// zoneMerge
+// Items moving over from another node were covered by that node's summary,
+// so merging the whole summary in keeps them covered
+template<typename T, int Size>
+void Lariat<T, Size>::zoneMerge(LNode *to, const LNode *from)
+{
+  if (!zones_)
+  {
+    return;
+  }
+  // Both summaries have to be current: a missing or stale one on to doesn't
+  // cover the items to already holds, so it is left for refreshZones to rebuild.
+  if (!from->zone || from->zone->stamp != zoneStamp_ ||
+      !to->zone || to->zone->stamp != zoneStamp_)
+  {
+    zoneDirty(to);
+    return;
+  }
+  zones_->merge(to->zone, from->zone);
+}
+
+template<typename T, int Size>
+void Lariat<T, Size>::zoneReset(LNode *node)
+{
+  if (zones_ && node->zone)
+  {
+    zones_->reset(node->zone);
+    node->zone->stamp = zoneStamp_;
+  }
+}
+
+template<typename T, int Size>
+void Lariat<T, Size>::zoneDirty(LNode *node)
+{
+  if (node->zone)
+  {
+    node->zone->stamp = 0;
+    zonesPending_ = true;
+  }
+}
+
+template<typename T, int Size>
+void Lariat<T, Size>::markZonesStale()
+{
+  if (zones_)
+  {
+    zoneStamp_++;
+    zonesPending_ = true;
+  }
+}
+
+// zoneOf
+// The summary a query may trust; a node without one has to be looked into
+template<typename T, int Size>
+const typename Lariat<T, Size>::LZone * Lariat<T, Size>::zoneOf(const LNode *node) const
+{
+  return zones_ && node->zone && node->zone->stamp == zoneStamp_ ? node->zone : nullptr;
+}
+
+// refreshZones
+// Summarises every node whose summary is missing or stale
+template<typename T, int Size>
+void Lariat<T, Size>::refreshZones()
+{
+  if (!zones_ || !zonesPending_)
+  {
+    return;
+  }
+  for (LNode *node = head_; node; node = node->next)
+  {
+    if (!node->zone)
+    {
+      node->zone = zones_->make();
+    }
+    if (node->zone->stamp != zoneStamp_)
+    {
+      zones_->reset(node->zone);
+      for (int i = 0; i < node->count; i++)
+      {
+        zones_->add(node->zone, node->values[slot(node, i)]);
+      }
+      node->zone->stamp = zoneStamp_;
+    }
+  }
+  zonesPending_ = false;
+}
+
+/*******************************************************************************
+================================= Value Index ==================================
+*******************************************************************************/
+
+// The index only needs T to be hashable once enable_index is called, so the
+// list talks to it through this interface and the hash table type is chosen
+// by enable_index.
+template<typename T, int Size>
+struct Lariat<T, Size>::LIndex
+{
+  typedef std::vector<std::pair<const LNode *, int> > Postings; // node, copies
+
+  virtual ~LIndex() {}
+  virtual LIndex *clone() const = 0; // empty index of the same kind
+  virtual void add(const LNode *node, const T &value) = 0;
+  virtual void remove(const LNode *node, const T &value) = 0;
+  virtual const Postings *lookup(const T &value) const = 0;
+  virtual void clear() = 0;
+};
+
+// Most values sit in one or two nodes, so each value keeps a short list of
+// (node, copies) pairs rather than a table of its own.
+template<typename T, int Size>
+template<typename Hash>
+struct Lariat<T, Size>::LHashIndex : Lariat<T, Size>::LIndex
+{
+  typedef typename LIndex::Postings Postings;
+  std::unordered_map<T, Postings, Hash> map;
+
+  LIndex *clone() const
+  {
+    return new LHashIndex();
+  }
+  void add(const LNode *node, const T &value)
+  {
+    Postings &postings = map[value];
+    for (size_t i = 0; i < postings.size(); i++)
+    {
+      if (postings[i].first == node)
+      {
+        postings[i].second++;
+        return;
+      }
+    }
+    postings.push_back(std::make_pair(node, 1));
+  }
+  void remove(const LNode *node, const T &value)
+  {
+    typename std::unordered_map<T, Postings, Hash>::iterator it = map.find(value);
+    Postings &postings = it->second;
+    for (size_t i = 0; i < postings.size(); i++)
+    {
+      if (postings[i].first == node)
+      {
+        if (--postings[i].second == 0)
+        {
+          postings[i] = postings.back();
+          postings.pop_back();
+        }
+        break;
+      }
+    }
+    if (postings.empty())
+    {
+      map.erase(it);
+    }
+  }
+  const Postings *lookup(const T &value) const
+  {
+    typename std::unordered_map<T, Postings, Hash>::const_iterator it = map.find(value);
+    return it == map.end() ? nullptr : &it->second;
+  }
+  void clear()
+  {
+    map.clear();
+  }
+};
+
+template<typename T, int Size>
+template<typename Hash>
+void Lariat<T, Size>::enable_index()
+{
+  delete index_;
+  index_ = new LHashIndex<Hash>();
+  settle();
+  rebuildIndex();
+}
+
+template<typename T, int Size>
+void Lariat<T, Size>::disable_index()
+{
+  delete index_;
+  index_ = nullptr;
+  indexStale_ = false;
+  for (LNode *node = head_; node; node = node->next)
+  {
+    node->unindexed = false;
+  }
+  unindexed_ = 0;
+}
+
+template<typename T, int Size>
+bool Lariat<T, Size>::indexed() const
+{
+  return index_ != nullptr;
+}
+
+template<typename T, int Size>
+void Lariat<T, Size>::indexAdd(const LNode *node, const T & value)
+{
+  if (index_ && !indexStale_ && !node->unindexed)
+  {
+    index_->add(node, value);
+  }
+}
+
+template<typename T, int Size>
+void Lariat<T, Size>::indexRemove(const LNode *node, const T & value)
+{
+  if (index_ && !indexStale_ && !node->unindexed)
+  {
+    index_->remove(node, value);
+  }
+}
+
+template<typename T, int Size>
+void Lariat<T, Size>::indexMove(const LNode *from, const LNode *to, const T & value)
+{
+  if (index_ && !indexStale_)
+  {
+    if (!from->unindexed)
+    {
+      index_->remove(from, value);
+    }
+    if (!to->unindexed)
+    {
+      index_->add(to, value);
+    }
+  }
+}
+
+template<typename T, int Size>
+void Lariat<T, Size>::markIndexStale()
+{
+  if (index_)
+  {
+    indexStale_ = true;
+  }
+}
+
+// indexForget
+// Takes node's items out of the index while a reference into the node may
+// still be written through, so the rest of the index stays current
+template<typename T, int Size>
+void Lariat<T, Size>::indexForget(LNode *node)
+{
+  if (!index_ || indexStale_ || node->unindexed)
+  {
+    return;
+  }
+  for (int i = 0; i < node->count; i++)
+  {
+    index_->remove(node, node->values[slot(node, i)]);
+  }
+  node->unindexed = true;
+  unindexed_++;
+}
+
+// rebuildIndex
+template<typename T, int Size>
+void Lariat<T, Size>::rebuildIndex()
+{
+  index_->clear();
+  for (LNode *node = head_; node; node = node->next)
+  {
+    node->unindexed = false;
+    for (int i = 0; i < node->count; i++)
+    {
+      index_->add(node, node->values[slot(node, i)]);
+    }
+  }
+  indexStale_ = false;
+  unindexed_ = 0;
+}
+
+// refreshIndex
+// Puts the items of the nodes indexForget took out back in, or rebuilds the
+// whole index if it was marked stale
+template<typename T, int Size>
+void Lariat<T, Size>::refreshIndex()
+{
+  if (!index_ || (!indexStale_ && !unindexed_))
+  {
+    return;
+  }
+  if (indexStale_)
+  {
+    rebuildIndex();
+    return;
+  }
+  for (LNode *node = head_; node && unindexed_; node = node->next)
+  {
+    if (node->unindexed)
+    {
+      node->unindexed = false;
+      unindexed_--;
+      for (int i = 0; i < node->count; i++)
+      {
+        index_->add(node, node->values[slot(node, i)]);
+      }
+    }
+  }
+}
+
+/*******************************************************************************
+========================== Data Structure Information ==========================
+*******************************************************************************/
+
+// find
+template<typename T, int Size>
+size_t Lariat<T, Size>::find(const T & value) const
+{
+  // With the index on, only the nodes holding the value are of interest,
+    // along with those taken out of it. The first of them in list order that
+    // holds the value has the first match; walking the node counts up to it
+    // gives the index of its first item.
+  if (index_ && !indexStale_)
+  {
+    const typename LIndex::Postings *postings = index_->lookup(value);
+    if (!postings && !unindexed_)
+    {
+      return size_;
+    }
+    std::vector<const LNode *> nodes;
+    nodes.reserve(postings ? postings->size() : 0);
+    for (size_t i = 0; postings && i < postings->size(); i++)
+    {
+      nodes.push_back((*postings)[i].first);
+    }
+    std::sort(nodes.begin(), nodes.end());
+    size_t globalIndex = 0;
+    for (LNode *node = head_; node; node = node->next)
+    {
+      if (node->unindexed || std::binary_search(nodes.begin(), nodes.end(), node))
+      {
+        for (int i = 0; i < node->count; i++)
+        {
+          if (node->values[slot(node, i)] == value)
+          {
+            return globalIndex + static_cast<size_t>(i);
+          }
+        }
+      }
+      globalIndex += static_cast<size_t>(node->count);
+    }
+    return size_;
+  }
+  // Walk the list in a similar fashion to that detailed in the findElement
+    // helper function, but check equivalence for each element in each node,
+    // returning the index when the desired element is found. Nodes whose
+    // zone map summary rules the value out are only counted.
+  size_t globalIndex = 0;
+  for (LNode *node = head_; node; node = node->next)
+  {
+    const LZone *zone = zoneOf(node);
+    if (!zone || zones_->mayHold(zone, value))
+    {
+      for (int i = 0; i < node->count; i++)
+      {
+        if (node->values[slot(node, i)] == value)
+        {
+          return globalIndex + static_cast<size_t>(i);
+        }
+      }
+    }
+    globalIndex += static_cast<size_t>(node->count);
+  }
+  // If the desired element is not found, return the total number of elements
+    // contained in the data structure.
+  return size_;
+}
+
+template<typename T, int Size>
+size_t Lariat<T, Size>::find(const T & value)
+{
+  prepareQuery();
+  return static_cast<const Lariat &>(*this).find(value);
+}
+
+// size
+template<typename T, int Size>
+size_t Lariat<T, Size>::size(void) const
+{
+  // You should be tracking the size_ member variable throughout the element
+    // addition and removal processes. Return that variable now.
+  return size_;
+}
+
+/*******************************************************************************
+============================ Data Structure Control ============================
+*******************************************************************************/
+
+// clear
+template<typename T, int Size>
+void Lariat<T, Size>::clear(void)
+{
+  // This is a relatively simple function with a similar algorithm to the
+    // class destructor.
+  // First, loop through the list, freeing each node in turn.
+  // Once the list is empty, update the necessary member variables.
+  while (head_)
+  {
+    removeNode(head_);
+  }
+  size_ = 0;
+  if (index_)
+  {
+    index_->clear();
+    indexStale_ = false;
+  }
+  unindexed_ = 0;
+}
+
+// compact
+template<typename T, int Size>
+void Lariat<T, Size>::compact()
+{
+  // Compact takes all the data stored in the linked list and moves it into the
+    // smallest number of nodes possible. Then it frees all empty nodes at the
+    // end of the list.
+  closeGap();
+  settle();
+  if (nodecount_ == 1 || head_ == nullptr)
+  {
+    return;
+  }
+  // The algorithm for this walks the list at two points in parallel. I will
+    // refer to the walker having elements shifted into it as the left foot and
+    // the walker reading through the elements to shift as the right foot,
+    // which is always the node right after the left foot.
+  // First, skip the nodes that are already full.
+  LNode *leftFoot = head_;
+  while (leftFoot->next && leftFoot->count == asize_)
+  {
+    leftFoot = leftFoot->next;
+  }
+  // Then move as many items as fit from the front of the right foot to the
+    // back of the left foot in one run. The right foot only gives up items at
+    // its front, so it just starts further into its block instead of shifting
+    // the rest down. Whichever foot runs out decides the next step: an empty
+    // right foot is removed, a full left foot hands over to the right foot,
+    // which is slid to the start of its block once, when it starts receiving.
+  while (leftFoot->next)
+  {
+    LNode *rightFoot = leftFoot->next;
+    slide(leftFoot, 0);
+    int run = asize_ - leftFoot->count < rightFoot->count ? asize_ - leftFoot->count : rightFoot->count;
+    T *to = leftFoot->values + leftFoot->count;
+    const T *from = rightFoot->values;
+    for (int i = 0; i < run; i++)
+    {
+      to[i] = from[i];
+      indexMove(rightFoot, leftFoot, to[i]);
+    }
+    zoneMerge(leftFoot, rightFoot);
+    leftFoot->count += run;
+    rightFoot->values += run;
+    rightFoot->count -= run;
+
+    if (rightFoot->count == 0)
+    {
+      removeNode(rightFoot);
+    }
+    else
+    {
+      leftFoot = rightFoot;
+    }
+  }
+}
+
+// rebalance
+template<typename T, int Size>
+void Lariat<T, Size>::rebalance(double target_fill)
+{
+  closeGap();
+  settle();
+  int target = static_cast<int>(target_fill * asize_ + 0.5);
+  if (target < 1)
+  {
+    target = 1;
+  }
+  else if (target > asize_)
+  {
+    target = asize_;
+  }
+
+  // Items may have to move towards the tail as well as towards the head, so
+    // rather than shuffling them between neighbours the list is streamed once
+    // into a fresh chain of nodes holding target items each. Every input node
+    // that has been drained is reused for the output before anything new is
+    // allocated.
+  LNode *input = head_;
+  LNode *drained = nullptr;
+  int read = 0;
+  head_ = nullptr;
+  tail_ = nullptr;
+  while (input)
+  {
+    if (read == input->count)
+    {
+      LNode *next = input->next;
+      input->next = drained;
+      drained = input;
+      input = next;
+      read = 0;
+      continue;
+    }
+    if (!tail_ || tail_->count == target)
+    {
+      if (drained)
+      {
+        LNode *node = drained;
+        drained = drained->next;
+        node->count = 0;
+        zoneReset(node);
+        detach(node);
+        node->values = node->block->values;
+        node->next = nullptr;
+        node->prev = tail_;
+        (tail_ ? tail_->next : head_) = node;
+        tail_ = node;
+      }
+      else
+      {
+        appendNode();
+      }
+    }
+    int run = target - tail_->count < input->count - read ? target - tail_->count : input->count - read;
+    T *to = tail_->values + tail_->count;
+    const T *from = input->values + read;
+    for (int i = 0; i < run; i++)
+    {
+      to[i] = from[i];
+      indexMove(input, tail_, to[i]);
+    }
+    zoneMerge(tail_, input);
+    tail_->count += run;
+    read += run;
+  }
+  while (drained)
+  {
+    LNode *next = drained->next;
+    nodecount_--;
+    freeNode(drained);
+    drained = next;
+  }
+}
+
+/*******************************************************************************
+============================== Segmented Access ================================
+*******************************************************************************/
+
+// segments
+template<typename T, int Size>
+typename Lariat<T, Size>::template SegmentRange<T> Lariat<T, Size>::segments()
+{
+  closeGap();
+  settle();
+  markIndexStale();
+  markZonesStale();
+  return SegmentRange<T>(this);
+}
+
+template<typename T, int Size>
+typename Lariat<T, Size>::template SegmentRange<const T> Lariat<T, Size>::segments() const
+{
+  return SegmentRange<const T>(this);
+}
+
+/*******************************************************************************
+=============================== Bulk Algorithms ================================
+*******************************************************************************/
+
+// for_each
+template<typename T, int Size>
+template<typename F>
+void Lariat<T, Size>::for_each(F f, unsigned threads)
+{
+  closeGap();
+  settle();
+  markIndexStale();
+  markZonesStale();
+  forSegments(threads, [this, &f](LNode *first, LNode *last, unsigned)
+  {
+    for (LNode *node = first; node != last; node = node->next)
+    {
+      detach(node);
+      T *values = node->values;
+      for (int i = 0, count = node->count; i < count; i++)
+      {
+        f(values[i]);
+      }
+    }
+  });
+}
+
+template<typename T, int Size>
+template<typename F>
+void Lariat<T, Size>::for_each(F f, unsigned threads) const
+{
+  forSegments(threads, [this, &f](LNode *first, LNode *last, unsigned)
+  {
+    for (LNode *node = first; node != last; node = node->next)
+    {
+      // The list may hold a gap or dead slots, which a const function can't
+      // squeeze out, so the items are visited run by run around them.
+      for (int i = 0, run; i < node->count; i += run)
+      {
+        const T *values = &node->values[slot(node, i)];
+        run = contiguous(node, i);
+        for (int k = 0; k < run; k++)
+        {
+          f(values[k]);
+        }
+      }
+    }
+  });
+}
+
+// transform
+template<typename T, int Size>
+template<typename F>
+void Lariat<T, Size>::transform(F f, unsigned threads)
+{
+  closeGap();
+  settle();
+  markIndexStale();
+  markZonesStale();
+  forSegments(threads, [this, &f](LNode *first, LNode *last, unsigned)
+  {
+    for (LNode *node = first; node != last; node = node->next)
+    {
+      detach(node);
+      T *values = node->values;
+      for (int i = 0, count = node->count; i < count; i++)
+      {
+        values[i] = f(values[i]);
+      }
+    }
+  });
+}
+
+// reduce
+template<typename T, int Size>
+template<typename R, typename Op>
+R Lariat<T, Size>::reduce(R init, Op op, unsigned threads) const
+{
+  // Every segment folds its own elements, starting from its first one, and
+  // the partial results are folded into init in list order afterwards.
+  if (!size_)
+  {
+    return init;
+  }
+  std::vector<R> partials(threads ? threads : std::thread::hardware_concurrency() + 1, init);
+  unsigned segments = forSegments(threads, [this, &op, &partials](LNode *first, LNode *last, unsigned segment)
+  {
+    R partial = static_cast<R>(first->values[slot(first, 0)]);
+    for (LNode *node = first; node != last; node = node->next)
+    {
+      // run by run around a gap or dead slots, as in for_each
+      for (int i = node == first ? 1 : 0, run; i < node->count; i += run)
+      {
+        const T *values = &node->values[slot(node, i)];
+        run = contiguous(node, i);
+        for (int k = 0; k < run; k++)
+        {
+          partial = op(partial, values[k]);
+        }
+      }
+    }
+    partials[segment] = partial;
+  });
+
+  R result = init;
+  for (unsigned segment = 0; segment < segments; segment++)
+  {
+    result = op(result, partials[segment]);
+  }
+  return result;
+}
+
+// forSegments
+// Cuts the list into at most threads runs of whole, non-empty nodes holding
+// about the same number of elements and calls work(first, last, segment) for
+// each [first, last) run, all but the first on their own thread. Returns the
+// number of segments.
+template<typename T, int Size>
+template<typename Work>
+unsigned Lariat<T, Size>::forSegments(unsigned threads, Work work) const
+{
+  if (!size_)
+  {
+    return 0;
+  }
+  if (threads == 0)
+  {
+    threads = std::thread::hardware_concurrency();
+  }
+  if (threads == 0)
+  {
+    threads = 1;
+  }
+
+  std::vector<LNode *> cuts;
+  cuts.push_back(head_);
+  while (!cuts.back()->count && cuts.back()->next)
+  {
+    cuts.back() = cuts.back()->next;
+  }
+  size_t perSegment = (size_ + threads - 1) / threads;
+  size_t seen = 0;
+  for (LNode *node = cuts.back(); node->next; node = node->next)
+  {
+    seen += static_cast<size_t>(node->count);
+    if (seen >= perSegment * cuts.size() && cuts.size() < threads && node->next->count)
+    {
+      cuts.push_back(node->next);
+    }
+  }
+  cuts.push_back(nullptr);
+
+  // An exception escaping a worker thread would terminate the program, so
+  // each segment parks it and the first one is rethrown after the join.
+  unsigned segments = static_cast<unsigned>(cuts.size() - 1);
+  std::vector<std::exception_ptr> errors(segments);
+  auto run = [&work, &cuts, &errors](unsigned segment)
+  {
+    try
+    {
+      work(cuts[segment], cuts[segment + 1], segment);
+    }
+    catch (...)
+    {
+      errors[segment] = std::current_exception();
+    }
+  };
+  std::vector<std::thread> workers;
+  for (unsigned segment = 1; segment < segments; segment++)
+  {
+    workers.push_back(std::thread(run, segment));
+  }
+  run(0);
+  for (std::thread &worker : workers)
+  {
+    worker.join();
+  }
+  for (std::exception_ptr const &error : errors)
+  {
+    if (error)
+    {
+      std::rethrow_exception(error);
+    }
+  }
+
+  return segments;
+}
+
+/*******************************************************************************
+=================================== Sorting ====================================
+*******************************************************************************/
+
+template<typename T, int Size>
+void Lariat<T, Size>::sort()
+{
+  sortNodes(std::less<T>(), 0, false);
+}
+
+template<typename T, int Size>
+template<typename Compare>
+void Lariat<T, Size>::sort(Compare comp, unsigned threads)
+{
+  sortNodes(comp, threads, false);
+}
+
+template<typename T, int Size>
+void Lariat<T, Size>::stable_sort()
+{
+  sortNodes(std::less<T>(), 0, true);
+}
+
+template<typename T, int Size>
+template<typename Compare>
+void Lariat<T, Size>::stable_sort(Compare comp, unsigned threads)
+{
+  sortNodes(comp, threads, true);
+}
+
+// sortNodes
+template<typename T, int Size>
+template<typename Compare>
+void Lariat<T, Size>::sortNodes(Compare comp, unsigned threads, bool stable)
+{
+  closeGap();
+  settle();
+  markIndexStale();
+  markZonesStale();
+  // Each node is already a contiguous array, so it is sorted in place as one
+  // run. The segments are spread over threads like the bulk algorithms.
+  forSegments(threads, [this, &comp, stable](LNode *first, LNode *last, unsigned)
+  {
+    for (LNode *node = first; node != last; node = node->next)
+    {
+      detach(node);
+      if (stable)
+      {
+        std::stable_sort(node->values, node->values + node->count, comp);
+      }
+      else
+      {
+        std::sort(node->values, node->values + node->count, comp);
+      }
+    }
+  });
+
+  // Then the sorted nodes are merged pairwise, pass after pass, with the
+  // merges of a pass spread over threads. Each merge fills its output nodes
+  // from the nodes it has drained, so only two extra nodes per worker, taken
+  // through makeNode, are live rather than a second copy of the list.
+  if (threads == 0)
+  {
+    threads = std::thread::hardware_concurrency();
+  }
+  if (threads == 0)
+  {
+    threads = 1;
+  }
+  std::vector<LRun> runs;
+  runs.reserve(static_cast<size_t>(nodecount_));
+  LNode *node = head_;
+  while (node)
+  {
+    LNode *next = node->next;
+    node->next = node->prev = nullptr;
+    if (node->count)
+    {
+      LRun run = { node, node };
+      runs.push_back(run);
+    }
+    else
+    {
+      nodecount_--;
+      freeNode(node);
+    }
+    node = next;
+  }
+
+  std::exception_ptr error;
+  LNode *idle = nullptr; // nodes for the merges to fill, linked through next
+  size_t idleCount = 0;
+  while (runs.size() > 1 && !error)
+  {
+    std::vector<LMerge> merges(runs.size() / 2);
+    unsigned workers = static_cast<unsigned>(std::min<size_t>(threads, merges.size()));
+    // Each worker starts with the two nodes mergeRuns needs beyond the ones
+    // it drains; the first pass makes them, later ones reuse leftovers.
+    try
+    {
+      for (; idleCount < 2 * workers; idleCount++)
+      {
+        LNode *node = makeNode();
+        node->next = idle;
+        idle = node;
+      }
+    }
+    catch (...)
+    {
+      error = std::current_exception();
+      break;
+    }
+    for (unsigned i = 0; i < 2 * workers; i++)
+    {
+      LNode *node = idle;
+      idle = node->next;
+      node->next = merges[i / 2].drained;
+      merges[i / 2].drained = node;
+    }
+    idleCount -= 2 * workers;
+    auto work = [this, &comp, &runs, &merges, workers](unsigned worker)
+    {
+      // A worker's merges hand their leftover drained nodes on to its next one.
+      LNode *drained = merges[worker].drained;
+      size_t i = worker;
+      for (; i < merges.size(); i += workers)
+      {
+        merges[i].drained = drained;
+        mergeRuns(runs[2 * i], runs[2 * i + 1], comp, merges[i]);
+        drained = merges[i].drained;
+        merges[i].drained = nullptr;
+      }
+      merges[i - workers].drained = drained;
+    };
+    std::vector<std::thread> pool;
+    for (unsigned worker = 1; worker < workers; worker++)
+    {
+      pool.push_back(std::thread(work, worker));
+    }
+    work(0);
+    for (std::thread &thread : pool)
+    {
+      thread.join();
+    }
+
+    // The leftover nodes are kept for the next pass.
+    std::vector<LRun> merged;
+    merged.reserve(merges.size() + 1);
+    for (LMerge &merge : merges)
+    {
+      while (merge.drained)
+      {
+        LNode *drained = merge.drained;
+        merge.drained = drained->next;
+        drained->next = idle;
+        idle = drained;
+        idleCount++;
+      }
+      merged.push_back(merge.out);
+      if (merge.error && !error)
+      {
+        error = merge.error;
+      }
+    }
+    if (runs.size() % 2)
+    {
+      merged.push_back(runs.back());
+    }
+    runs.swap(merged);
+  }
+  while (idle)
+  {
+    LNode *next = idle->next;
+    nodecount_--;
+    freeNode(idle);
+    idle = next;
+  }
+
+  head_ = nullptr;
+  tail_ = nullptr;
+  for (LRun &run : runs)
+  {
+    run.head->prev = tail_;
+    (tail_ ? tail_->next : head_) = run.head;
+    tail_ = run.tail;
+  }
+  if (error)
+  {
+    std::rethrow_exception(error);
+  }
+}
+
+template<typename T, int Size>
+struct Lariat<T, Size>::LRun
+{
+  LNode *head;
+  LNode *tail;
+};
+
+template<typename T, int Size>
+struct Lariat<T, Size>::LMerge
+{
+  LRun               out;     // the merged run
+  LNode             *drained; // spare nodes for out, linked through next
+  std::exception_ptr error;   // out then holds the unmerged items as well
+};
+
+// mergeRuns
+// Merges two sorted runs into full nodes taken from merge.drained. Ties go
+// to left, which keeps stable_sort stable. Only touches the nodes of the two
+// runs and merge, so merges of different runs can run in parallel.
+// Two nodes in merge.drained up front are enough: when the k full output
+// nodes need a successor, their k * Size items came from the d nodes drained
+// so far plus less than a node from each side, so k <= d + 1.
+template<typename T, int Size>
+template<typename Compare>
+void Lariat<T, Size>::mergeRuns(LRun left, LRun right, Compare &comp, LMerge &merge)
+{
+  merge.out.head = merge.out.tail = nullptr;
+  LNode *from[2] = { left.head, right.head };
+  int index[2] = { 0, 0 };
+  try
+  {
+    while (from[0] || from[1])
+    {
+      int side = !from[0] || (from[1] && comp(from[1]->values[index[1]], from[0]->values[index[0]]));
+      if (!merge.out.tail || merge.out.tail->count == asize_)
+      {
+        LNode *node = merge.drained;
+        merge.drained = node->next;
+        node->values = node->block->values;
+        node->count = 0;
+        node->next = nullptr;
+        node->prev = merge.out.tail;
+        (merge.out.tail ? merge.out.tail->next : merge.out.head) = node;
+        merge.out.tail = node;
+      }
+      merge.out.tail->values[merge.out.tail->count++] = std::move(from[side]->values[index[side]]);
+      if (++index[side] == from[side]->count)
+      {
+        LNode *next = from[side]->next;
+        from[side]->next = merge.drained;
+        merge.drained = from[side];
+        from[side] = next;
+        index[side] = 0;
+      }
+    }
+  }
+  catch (...)
+  {
+    // Nothing is lost: what is left of both runs goes after the output,
+    // unsorted, minus the items already merged off the front.
+    merge.error = std::current_exception();
+    for (int side = 0; side < 2; side++)
+    {
+      LNode *node = from[side];
+      if (!node)
+      {
+        continue;
+      }
+      for (int i = index[side]; i < node->count; i++)
+      {
+        node->values[i - index[side]] = std::move(node->values[i]);
+      }
+      node->count -= index[side];
+      node->prev = merge.out.tail;
+      (merge.out.tail ? merge.out.tail->next : merge.out.head) = node;
+      merge.out.tail = side ? right.tail : left.tail;
+    }
+  }
+}
+
+/*******************************************************************************
+============================== Binary Persistence ==============================
+*******************************************************************************/
+
+// Binary layout, all fields in host byte order:
+//   char[4]   magic "LRAT"
+//   uint32    format version
+//   uint32    sizeof(T)
+//   uint64    number of elements
+//   then one record per node: uint32 count, followed by count raw elements
+// The node size of the writer is not stored; load packs the elements into
+// full nodes of its own Size regardless of how they were split when saved.
+namespace LariatFormat
+{
+  const char     magic[4] = { 'L', 'R', 'A', 'T' };
+  const uint32_t version = 1;
+}
+
+// save
+template<typename T, int Size>
+void Lariat<T, Size>::save(std::ostream & os) const
+{
+  static_assert(std::is_trivially_copyable<T>::value,
+                "Lariat::save requires a trivially copyable element type");
+
+  uint32_t version = LariatFormat::version;
+  uint32_t elementSize = sizeof(T);
+  uint64_t count = static_cast<uint64_t>(size_);
+  os.write(LariatFormat::magic, sizeof(LariatFormat::magic));
+  os.write(reinterpret_cast<const char *>(&version), sizeof(version));
+  os.write(reinterpret_cast<const char *>(&elementSize), sizeof(elementSize));
+  os.write(reinterpret_cast<const char *>(&count), sizeof(count));
+
+  // Each node's elements are already contiguous, so they go out in one write.
+  for (LNode *node = head_; node; node = node->next)
+  {
+    // (one write per run for a node holding the gap or dead slots)
+    uint32_t nodeCount = static_cast<uint32_t>(node->count);
+    os.write(reinterpret_cast<const char *>(&nodeCount), sizeof(nodeCount));
+    for (int i = 0, run; i < node->count; i += run)
+    {
+      run = contiguous(node, i);
+      os.write(reinterpret_cast<const char *>(&node->values[slot(node, i)]),
+               static_cast<std::streamsize>(sizeof(T) * static_cast<size_t>(run)));
+    }
+  }
+
+  if (!os)
+  {
+    throw LariatException(LariatException::E_DATA_ERROR, "Failed to write lariat");
+  }
+}
+
+// load
+template<typename T, int Size>
+void Lariat<T, Size>::load(std::istream & is)
+{
+  static_assert(std::is_trivially_copyable<T>::value,
+                "Lariat::load requires a trivially copyable element type");
+
+  char magic[4] = {};
+  uint32_t version = 0;
+  uint32_t elementSize = 0;
+  uint64_t count = 0;
+  is.read(magic, sizeof(magic));
+  is.read(reinterpret_cast<char *>(&version), sizeof(version));
+  is.read(reinterpret_cast<char *>(&elementSize), sizeof(elementSize));
+  is.read(reinterpret_cast<char *>(&count), sizeof(count));
+  if (!is || std::memcmp(magic, LariatFormat::magic, sizeof(magic)) != 0)
+  {
+    throw LariatException(LariatException::E_DATA_ERROR, "Not a lariat stream");
+  }
+  if (version != LariatFormat::version || elementSize != sizeof(T))
+  {
+    throw LariatException(LariatException::E_DATA_ERROR, "Incompatible lariat stream");
+  }
+
+  clear();
+  // Records are read straight into the free tail of the last node, so each
+  // node is filled completely before the next one is allocated. A bounded
+  // list skips the items in front of the last maxSize_.
+  uint64_t skip = maxSize_ && count > maxSize_ ? count - maxSize_ : 0;
+  uint64_t loaded = 0;
+  while (loaded < count)
+  {
+    uint32_t nodeCount = 0;
+    is.read(reinterpret_cast<char *>(&nodeCount), sizeof(nodeCount));
+    if (!is || nodeCount > count - loaded)
+    {
+      clear();
+      throw LariatException(LariatException::E_DATA_ERROR, "Corrupt lariat stream");
+    }
+    if (skip)
+    {
+      uint32_t skipped = skip < nodeCount ? static_cast<uint32_t>(skip) : nodeCount;
+      is.ignore(static_cast<std::streamsize>(sizeof(T)) * skipped);
+      if (is.gcount() != static_cast<std::streamsize>(sizeof(T)) * skipped)
+      {
+        clear();
+        throw LariatException(LariatException::E_DATA_ERROR, "Corrupt lariat stream");
+      }
+      skip -= skipped;
+      nodeCount -= skipped;
+      loaded += skipped;
+    }
+    while (nodeCount)
+    {
+      if (!tail_ || tail_->count == asize_)
+      {
+        appendNode();
+      }
+      int room = asize_ - tail_->count;
+      int chunk = nodeCount < static_cast<uint32_t>(room) ? static_cast<int>(nodeCount) : room;
+      is.read(reinterpret_cast<char *>(tail_->values + tail_->count),
+              static_cast<std::streamsize>(sizeof(T)) * chunk);
+      if (!is)
+      {
+        clear();
+        throw LariatException(LariatException::E_DATA_ERROR, "Corrupt lariat stream");
+      }
+      tail_->count += chunk;
+      size_ += static_cast<size_t>(chunk);
+      nodeCount -= static_cast<uint32_t>(chunk);
+      loaded += static_cast<uint64_t>(chunk);
+    }
+  }
+  markIndexStale();
+  markZonesStale();
+}
+
+// split
+template<typename T, int Size>
+void Lariat<T, Size>::split(LNode * node, SplitType type)
+{
+  // This helper function takes a full node and splits into two nodes of an
+  // aproximately equivalent number of elements.
+  // First, create a new node to split the original node into.
+  // Calculate the index from which to move elements over from. This should
+  // account for an element being appended to the second node after the
+  // function has been called. If you're implementing this with overflow,
+  // you should have already worked out how the overflow gets assigned its
+  // position.
+  // Loop through the elements from the index in the first node, transferring
+  // them each to the newly added node. Update the added node's count during
+  // the loop.
+      //...See handout for diagram
+
+  // Set the count of the original node to index, and insert the added node
+  // immediately after the original node.
+  if (node == gapNode_)
+  {
+    closeGap();
+  }
+  settleNode(node);
+  LNode *newNode = makeNode();
+  LNode *oldNext = nullptr;
+  if (node->next)
+  {
+    oldNext = node->next;
+    oldNext->prev = newNode;
+  }
+  newNode->next = node->next;
+  newNode->prev = node;
+  node->next = newNode;
+
+  int newNodeCount;
+  if (asize_ % 2)
+  {
+    if (type == SplitType::TOPHEAVY)
+    {
+      newNodeCount = (asize_ / 2) + 1;
+      newNode->count = newNodeCount - 1;
+    }
+    else
+    {
+      newNodeCount = (asize_ / 2);
+      newNode->count = newNodeCount + 1;
+    }
+  }
+  else
+  {
+    if (type == SplitType::TOPHEAVY)
+    {
+      newNodeCount = (asize_ / 2) + 1;
+      newNode->count = newNodeCount - 2;
+    }
+    else
+    {
+      newNodeCount = asize_ / 2;
+      newNode->count = newNodeCount;
+    }
+  }
+
+  for (int i = 0; i < asize_ - newNodeCount; i++)
+  {
+    newNode->values[i] = node->values[newNodeCount + i];
+    indexMove(node, newNode, newNode->values[i]);
+  }
+  zoneMerge(newNode, node);
+
+  node->count = newNodeCount;
+}
+
+// findElement
+template<typename T, int Size>
+typename Lariat<T, Size>::IndexedNode Lariat<T, Size>::findElement(size_t index) const
+{
+  // This function takes a global index to find in the deque and must return
+  // both a pointer to the node in the list and the local index of the element
+  // in the returned node.
+  // Clearly returning multiple variables is a *small* challenge in C and C++,
+  // so you will have to find a way to work around that.
+  // The algorithm for this function is focused around looping through the list
+  // and tracking the total number of elements stored before the current
+  // node. I used a counter and added each node's count until I passed the
+  // desired global index.
+  // Because each node in the list only stores the number of elements it is
+  // using actively, the count of each has to be added individually to keep an
+  // accurate count of the number of elements that have been stepped over.
+  if (!head_)
+  {
+    IndexedNode nullNode; 
+    nullNode.node = nullptr;
+    nullNode.index = 0;
+    return nullNode;
+  }
+
+  if (index < static_cast<size_t>(head_->count))
+  {
+    IndexedNode onlyNode;
+    onlyNode.node = head_;
+    onlyNode.index = static_cast<int>(index);
+    return onlyNode;
+  }
+
+  // The global index only becomes small enough for an int once it is local
+    // to the node holding it.
+  size_t newIndex = index;
+  LNode *node = head_;
+  while (node->next)
+  {
+    newIndex -= static_cast<size_t>(node->count);
     node = node->next;
-    if (newIndex < node->count)
+    if (newIndex < static_cast<size_t>(node->count))
+    {
+      break;
+    }
+  }
+  IndexedNode iNode;
+  iNode.node = node;
+  iNode.index = static_cast<int>(newIndex);
+
+  return iNode;
+}
+
+// shiftUp
+template<typename T, int Size>
+void Lariat<T, Size>::shiftUp(LNode *node, int index)
+{
+  // This helper function is almost identical to one that was particularly
+  // useful for the CS170 Vector lab. It uses a simple swap algorithm to swap
+  // every element between the index and the last element in the node's array
+  // in place.
+  // Make sure your bound-checking is good and you have accurately defined the
+  // limits of your memory. If you find a wrong value somewhere unexpected,
+  // you probably have the index limit wrong somehow.
+    //...See handout for diagram
+  if (node == gapNode_)
+  {
+    closeGap();
+  }
+  settleNode(node);
+  detach(node);
+
+  // Items don't have to start at the beginning of the block, so the slot can
+  // be opened by moving the items in front of index down instead of the ones
+  // behind it up, whichever side is shorter and has room. An operation at
+  // either end of a node that has no room on that side moves all the free
+  // slots there first, which makes repeated push_front/push_back O(1).
+  int front = frontRoom(node);
+  int back = backRoom(node);
+  if (index == node->count && !back)
+  {
+    slide(node, 0);
+    back = front;
+    front = 0;
+  }
+  else if (index == 0 && !front)
+  {
+    slide(node, back);
+    front = back;
+    back = 0;
+  }
+
+  if (front && (!back || index < node->count - index))
+  {
+    node->values--;
+    for (int i = 0; i < index; i++)
+    {
+      node->values[i] = node->values[i + 1];
+    }
+    return;
+  }
+
+  for (int i = index; i < node->count; i++)
+  {
+    node->values[node->count - (i - index)] = node->values[(node->count - 1) - (i - index)];
+  }
+
+  // I would highly recommend writing a templatized swap function. It has uses
+  // in most basic algorithms related to data structures.
+}
+
+// shiftDown 
+template<typename T, int Size>
+void Lariat<T, Size>::shiftDown(LNode *node, int index)
+{
+  // The shift down helper function works very similarly to the shift up, by
+  // swapping values in the node's array.
+  // The key difference between the two is that the shift down function does
+  // not have a fixed index. It should move down the array, swapping each
+  // element with the element immediately before it. In this way, it still
+  // preserves the data it is writing over, but does so by shifting it from
+  // the start of the range to the end rather than the opposited direction.
+  if (node == gapNode_)
+  {
+    closeGap();
+  }
+  settleNode(node);
+  detach(node);
+  // Closing the gap from the front only needs the start of the node to move
+  // up one slot, so pop_front never moves anything.
+  if (index < node->count - 1 - index)
+  {
+    for (int i = index; i > 0; i--)
+    {
+      node->values[i] = node->values[i - 1];
+    }
+    node->values++;
+    return;
+  }
+  for (int i = index; i + 1 < node->count; i++)
+  {
+    node->values[i] = node->values[i + 1];
+  }
+}
+
+template<typename T, int Size>
+int Lariat<T, Size>::frontRoom(const LNode *node) const
+{
+  return static_cast<int>(node->values - node->block->values);
+}
+
+template<typename T, int Size>
+int Lariat<T, Size>::backRoom(const LNode *node) const
+{
+  return asize_ - frontRoom(node) - windowLength(node);
+}
+
+// slide
+// Moves the items of node so the first one sits at block->values[start]
+template<typename T, int Size>
+void Lariat<T, Size>::slide(LNode *node, int start)
+{
+  settleNode(node);
+  detach(node);
+  T *target = node->block->values + start;
+  if (target < node->values)
+  {
+    for (int i = 0; i < node->count; i++)
+    {
+      target[i] = node->values[i];
+    }
+  }
+  else if (target > node->values)
+  {
+    for (int i = node->count - 1; i >= 0; i--)
+    {
+      target[i] = node->values[i];
+    }
+  }
+  node->values = target;
+}
+
+/*******************************************************************************
+============================== Node Preallocation ===============================
+*******************************************************************************/
+
+// reserve
+// push_back leaves the nodes it splits Size / 2 + 1 full and inserts in the
+// middle as little as Size / 2, so that is what each node is counted for
+template<typename T, int Size>
+void Lariat<T, Size>::reserve(size_t n)
+{
+  size_t fill = asize_ > 1 ? static_cast<size_t>(asize_ / 2) : 1;
+  size_t nodes = (n + fill - 1) / fill;
+  if (nodes > reserved_)
+  {
+    reserved_ = nodes;
+  }
+  fitSpares();
+}
+
+// capacity
+template<typename T, int Size>
+size_t Lariat<T, Size>::capacity() const
+{
+  return (nodecount_ + sparecount_ + inline_.available()) * static_cast<size_t>(asize_);
+}
+
+// shrink_to_fit
+template<typename T, int Size>
+void Lariat<T, Size>::shrink_to_fit()
+{
+  reserved_ = 0;
+  compact();
+  // Spares a bounded list kept go too; it collects them again as nodes empty.
+  while (spare_)
+  {
+    LNode *next = spare_->next;
+    releaseBlock(spare_->block);
+    delete spare_;
+    spare_ = next;
+    sparecount_--;
+  }
+}
+
+/*******************************************************************************
+================================= Bounded Mode =================================
+*******************************************************************************/
+
+// set_max_size
+template<typename T, int Size>
+void Lariat<T, Size>::set_max_size(size_t n)
+{
+  maxSize_ = n;
+  evictFront();
+  fitSpares();
+}
+
+// max_size
+template<typename T, int Size>
+size_t Lariat<T, Size>::max_size() const
+{
+  return maxSize_;
+}
+
+// keptNodes
+// A full window spans at most one node more than its items fill. Keeping that
+// many nodes makes freeNode hold on to emptied nodes as spares for new ones;
+// unlike reserve, nothing is allocated up front.
+template<typename T, int Size>
+size_t Lariat<T, Size>::keptNodes() const
+{
+  size_t window = maxSize_ ? (maxSize_ + static_cast<size_t>(asize_) - 1) / static_cast<size_t>(asize_) + 1 : 0;
+  return window > reserved_ ? window : reserved_;
+}
+
+// fitSpares
+template<typename T, int Size>
+void Lariat<T, Size>::fitSpares()
+{
+  while (spare_ && nodecount_ + sparecount_ > keptNodes())
+  {
+    LNode *next = spare_->next;
+    releaseBlock(spare_->block);
+    delete spare_;
+    spare_ = next;
+    sparecount_--;
+  }
+  while (nodecount_ + sparecount_ + inline_.available() < reserved_)
+  {
+    LNode *node = new LNode();
+    node->block = new LBlock();
+    node->values = node->block->values;
+    node->next = spare_;
+    spare_ = node;
+    sparecount_++;
+  }
+}
+
+// evictFront
+template<typename T, int Size>
+void Lariat<T, Size>::evictFront()
+{
+  while (maxSize_ && size_ > maxSize_)
+  {
+    pop_front();
+  }
+}
+
+/*******************************************************************************
+================================= Gap Buffer ===================================
+*******************************************************************************/
+
+// While gap buffer mode is on, at most one node (gapNode_) holds a gap: a run
+// of free slots between its item gapIndex_ - 1 and item gapIndex_. Inserts and
+// erases in that node move the gap to the edit position and then fill or grow
+// it, so a burst of edits around one spot moves only the items between
+// consecutive edit positions. Editing another node, or anything that needs the
+// node's items contiguous, closes the gap first.
+
+template<typename T, int Size>
+void Lariat<T, Size>::set_gap_buffer(bool enable)
+{
+  if (!enable)
+  {
+    closeGap();
+  }
+  else
+  {
+    set_lazy_erase(false);
+  }
+  gapMode_ = enable;
+}
+
+template<typename T, int Size>
+bool Lariat<T, Size>::gap_buffer() const
+{
+  return gapMode_;
+}
+
+template<typename T, int Size>
+int Lariat<T, Size>::slot(const LNode *node, int index) const
+{
+  if (node->deadCount)
+  {
+    return liveSlot(node, index);
+  }
+  return node == gapNode_ && index >= gapIndex_ ? index + gapLength_ : index;
+}
+
+// contiguous
+// Items from index on that sit next to each other in values[], up to the gap
+// or the next dead slot
+template<typename T, int Size>
+int Lariat<T, Size>::contiguous(const LNode *node, int index) const
+{
+  if (node->deadCount)
+  {
+    int from = liveSlot(node, index);
+    int to = from + 1;
+    int window = node->count + node->deadCount;
+    while (to < window && !((node->dead[to / 64] >> (to % 64)) & 1))
+    {
+      to++;
+    }
+    return to - from;
+  }
+  return node == gapNode_ && index < gapIndex_ ? gapIndex_ - index : node->count - index;
+}
+
+template<typename T, int Size>
+int Lariat<T, Size>::windowLength(const LNode *node) const
+{
+  return node == gapNode_ ? node->count + gapLength_ : node->count + node->deadCount;
+}
+
+// closeGap
+// Makes the gap node contiguous again by moving the shorter side of the gap,
+// the free slots end up in front of or behind the items
+template<typename T, int Size>
+void Lariat<T, Size>::closeGap()
+{
+  if (!gapNode_)
+  {
+    return;
+  }
+  LNode *node = gapNode_;
+  detach(node);
+  T *values = node->values;
+  if (gapIndex_ < node->count - gapIndex_)
+  {
+    for (int i = gapIndex_ - 1; i >= 0; i--)
+    {
+      values[i + gapLength_] = values[i];
+    }
+    node->values += gapLength_;
+  }
+  else
+  {
+    for (int i = gapIndex_; i < node->count; i++)
+    {
+      values[i] = values[i + gapLength_];
+    }
+  }
+  gapNode_ = nullptr;
+  gapIndex_ = 0;
+  gapLength_ = 0;
+}
+
+// moveGap
+// Moves the gap of the (already unshared) gap node to sit in front of item index
+template<typename T, int Size>
+void Lariat<T, Size>::moveGap(int index)
+{
+  T *values = gapNode_->values;
+  while (gapIndex_ > index)
+  {
+    gapIndex_--;
+    values[gapIndex_ + gapLength_] = values[gapIndex_];
+  }
+  while (gapIndex_ < index)
+  {
+    values[gapIndex_] = values[gapIndex_ + gapLength_];
+    gapIndex_++;
+  }
+}
+
+// gapInsert
+template<typename T, int Size>
+void Lariat<T, Size>::gapInsert(LNode *node, int index, const T & value)
+{
+  if (node != gapNode_)
+  {
+    closeGap();
+    gapNode_ = node;
+    gapIndex_ = index;
+    gapLength_ = 0;
+  }
+  detach(node);
+  moveGap(index);
+
+  // An empty gap takes all the free slots from whichever end of the node is
+  // cheaper to move out of the way.
+  if (!gapLength_)
+  {
+    int front = frontRoom(node);
+    int back = backRoom(node);
+    if (back && (!front || node->count - index <= index))
+    {
+      for (int i = node->count - 1; i >= index; i--)
+      {
+        node->values[i + back] = node->values[i];
+      }
+      gapLength_ = back;
+    }
+    else
+    {
+      node->values -= front;
+      for (int i = 0; i < index; i++)
+      {
+        node->values[i] = node->values[i + front];
+      }
+      gapLength_ = front;
+    }
+  }
+
+  node->values[gapIndex_] = value;
+  gapIndex_++;
+  gapLength_--;
+  node->count++;
+}
+
+// gapErase
+template<typename T, int Size>
+void Lariat<T, Size>::gapErase(LNode *node, int index)
+{
+  if (node != gapNode_)
+  {
+    closeGap();
+    gapNode_ = node;
+    gapIndex_ = index;
+    gapLength_ = 0;
+  }
+  detach(node);
+  // The gap swallows the item, from whichever side of the gap it is on.
+  if (index < gapIndex_)
+  {
+    moveGap(index + 1);
+    gapIndex_--;
+  }
+  else
+  {
+    moveGap(index);
+  }
+  gapLength_++;
+  node->count--;
+}
+
+/*******************************************************************************
+================================= Lazy Erase ===================================
+*******************************************************************************/
+
+// While lazy erase mode is on, erasing from the middle of a node only sets the
+// item's bit in the node's dead bitmap. The bitmap covers the node's window
+// of slots from values on, so a node with dead slots maps item indices to
+// slots by counting live bits (liveSlot). Anything that moves the window
+// squeezes the dead slots out of that node first (settleNode), and the
+// non-const members that walk the whole list do it for every node (settle).
+// Const members only read the bitmaps, a reference into the list stays valid
+// across them.
+
+template<typename T, int Size>
+void Lariat<T, Size>::set_lazy_erase(bool enable)
+{
+  if (!enable)
+  {
+    settle();
+  }
+  else
+  {
+    set_gap_buffer(false);
+  }
+  lazyErase_ = enable;
+}
+
+template<typename T, int Size>
+bool Lariat<T, Size>::lazy_erase() const
+{
+  return lazyErase_;
+}
+
+// liveSlot
+// Whole words of the bitmap are skipped by their popcount, then the bits of
+// the word holding the item are cleared up to it
+template<typename T, int Size>
+int Lariat<T, Size>::liveSlot(const LNode *node, int index) const
+{
+  int window = node->count + node->deadCount;
+  for (int base = 0; base < window; base += 64)
+  {
+    uint64_t live = ~node->dead[base / 64];
+    if (window - base < 64)
     {
-      break;
+      live &= (uint64_t(1) << (window - base)) - 1;
+    }
+    int inWord = static_cast<int>(std::bitset<64>(live).count());
+    if (index < inWord)
+    {
+      for (; index; index--)
+      {
+        live &= live - 1;
+      }
+      return base + static_cast<int>(std::bitset<64>((live & (~live + 1)) - 1).count());
     }
+    index -= inWord;
   }
-  IndexedNode iNode;
-  iNode.node = node;
-  iNode.index = newIndex;
-
-  return iNode;
+  return window;
 }
 
-// shiftUp
+// lazyErase
+// The bitmap belongs to the node, so marking a slot dead writes nothing to a
+// block that may still be shared with a copy
 template<typename T, int Size>
-void Lariat<T, Size>::shiftUp(LNode *node, int index)
+void Lariat<T, Size>::lazyErase(LNode *node, int index)
 {
-  // This helper function is almost identical to one that was particularly
-  // useful for the CS170 Vector lab. It uses a simple swap algorithm to swap
-  // every element between the index and the last element in the node's array
-  // in place.
-  // Make sure your bound-checking is good and you have accurately defined the
-  // limits of your memory. If you find a wrong value somewhere unexpected,
-  // you probably have the index limit wrong somehow.
-    //...See handout for diagram
+  int dead = slot(node, index);
+  if (!node->dead)
+  {
+    node->dead = new uint64_t[(asize_ + 63) / 64]();
+  }
+  node->dead[dead / 64] |= uint64_t(1) << (dead % 64);
+  node->deadCount++;
+  node->count--;
+  deadTotal_++;
+}
 
-  for (int i = index; i < node->count; i++)
+// settleNode
+template<typename T, int Size>
+void Lariat<T, Size>::settleNode(LNode *node)
+{
+  if (!node->deadCount)
   {
-    node->values[node->count - (i - index)] = node->values[(node->count - 1) - (i - index)];
+    return;
   }
+  detach(node);
+  T *values = node->values;
+  int window = node->count + node->deadCount;
+  int to = 0;
+  for (int from = 0; from < window; from++)
+  {
+    if (!((node->dead[from / 64] >> (from % 64)) & 1))
+    {
+      if (to != from)
+      {
+        values[to] = values[from];
+      }
+      to++;
+    }
+  }
+  deadTotal_ -= static_cast<size_t>(node->deadCount);
+  node->deadCount = 0;
+  delete[] node->dead;
+  node->dead = nullptr;
+}
 
-  // I would highly recommend writing a templatized swap function. It has uses
-  // in most basic algorithms related to data structures.
+// settle
+template<typename T, int Size>
+void Lariat<T, Size>::settle()
+{
+  if (!deadTotal_)
+  {
+    return;
+  }
+  for (LNode *node = head_; node; node = node->next)
+  {
+    settleNode(node);
+  }
 }
 
-// shiftDown 
+// copyDead
 template<typename T, int Size>
-void Lariat<T, Size>::shiftDown(LNode *node, int index)
+void Lariat<T, Size>::copyDead(LNode *to, const LNode *from)
 {
-  // The shift down helper function works very similarly to the shift up, by
-  // swapping values in the node's array.
-  // The key difference between the two is that the shift down function does
-  // not have a fixed index. It should move down the array, swapping each
-  // element with the element immediately before it. In this way, it still
-  // preserves the data it is writing over, but does so by shifting it from
-  // the start of the range to the end rather than the opposited direction.
-  for (int i = index; i < node->count; i++)
+  if (!from->deadCount)
   {
-    node->values[i] = node->values[i + 1];
+    return;
   }
+  int words = (asize_ + 63) / 64;
+  to->dead = new uint64_t[words];
+  std::memcpy(to->dead, from->dead, sizeof(uint64_t) * static_cast<size_t>(words));
+  to->deadCount = from->deadCount;
+  deadTotal_ += static_cast<size_t>(from->deadCount);
+}
+
+// prepareQuery
+// The lazy upkeep the queries do on a non-const list, so they can use the
+// whole index and every summary
+template<typename T, int Size>
+void Lariat<T, Size>::prepareQuery()
+{
+  refreshIndex();
+  refreshZones();
 }
 
 template<typename T, int Size>
 typename Lariat<T, Size>::LNode * Lariat<T, Size>::makeNode()
+{
+  // The inline node and then reserved spare nodes go first, the allocator is
+  // only used once they have run out.
+  LNode *newNode = inline_.take();
+  if (!newNode && spare_)
+  {
+    newNode = spare_;
+    spare_ = newNode->next;
+    sparecount_--;
+    newNode->next = nullptr;
+    newNode->count = 0;
+  }
+  else if (!newNode)
+  {
+    newNode = new LNode();
+    newNode->block = new LBlock();
+  }
+  newNode->values = newNode->block->values;
+  newNode->exposed = false;
+  newNode->unindexed = false;
+  if (zones_)
+  {
+    zonesPending_ = true;
+  }
+  nodecount_++;
+
+  return newNode;
+}
+
+// linkAfter
+// Links a new, empty node after node
+template<typename T, int Size>
+typename Lariat<T, Size>::LNode * Lariat<T, Size>::linkAfter(LNode *node)
+{
+  LNode *newNode = makeNode();
+  newNode->prev = node;
+  newNode->next = node->next;
+  if (node->next)
+  {
+    node->next->prev = newNode;
+  }
+  else
+  {
+    tail_ = newNode;
+  }
+  node->next = newNode;
+
+  return newNode;
+}
+
+// appendNode
+// Links a new, empty node after the current tail
+template<typename T, int Size>
+typename Lariat<T, Size>::LNode * Lariat<T, Size>::appendNode()
+{
+  LNode *newNode = makeNode();
+  newNode->prev = tail_;
+  if (tail_)
+  {
+    tail_->next = newNode;
+  }
+  else
+  {
+    head_ = newNode;
+  }
+  tail_ = newNode;
+
+  return newNode;
+}
+
+// shareNode
+// A new, unlinked node holding the same elements as node without copying them
+template<typename T, int Size>
+typename Lariat<T, Size>::LNode * Lariat<T, Size>::shareNode(LNode *node)
 {
   LNode *newNode = new LNode();
+  newNode->count = node->count;
+  newNode->block = node->block;
+  newNode->values = node->values;
+  node->block->refs.fetch_add(1, std::memory_order_relaxed);
   nodecount_++;
 
   return newNode;
 }
 
+// copyNode
+// A new, unlinked node holding copies of node's items at the same offset
+template<typename T, int Size>
+typename Lariat<T, Size>::LNode * Lariat<T, Size>::copyNode(const LNode *node)
+{
+  LNode *newNode = makeNode();
+  newNode->count = node->count;
+  newNode->values = newNode->block->values + (node->values - node->block->values);
+  // The whole block, since a gap may sit anywhere inside the window.
+  for (int i = 0; i < asize_; i++)
+  {
+    newNode->block->values[i] = node->block->values[i];
+  }
+
+  return newNode;
+}
+
+// steal
+// Takes over all of rhs's nodes, leaving it empty; rhs's inline node can't
+// move, so its items are moved into this list's own inline node, which is
+// free, together with its dead slot bitmap. Nothing is allocated.
+template<typename T, int Size>
+void Lariat<T, Size>::steal(Lariat &rhs)
+{
+  lazyErase_ = rhs.lazyErase_;
+  deadTotal_ = rhs.deadTotal_;
+  maxSize_ = rhs.maxSize_;
+  head_ = rhs.head_;
+  tail_ = rhs.tail_;
+  size_ = rhs.size_;
+  nodecount_ = rhs.nodecount_;
+  asize_ = rhs.asize_;
+  spare_ = rhs.spare_;
+  sparecount_ = rhs.sparecount_;
+  reserved_ = rhs.reserved_;
+  gapMode_ = rhs.gapMode_;
+  gapNode_ = rhs.gapNode_;
+  gapIndex_ = rhs.gapIndex_;
+  gapLength_ = rhs.gapLength_;
+  index_ = rhs.index_;
+  markIndexStale();
+  unindexed_ = rhs.unindexed_;
+  zones_ = rhs.zones_;
+  zoneStamp_ = rhs.zoneStamp_;
+  zonesPending_ = rhs.zonesPending_;
+
+  for (LNode *node = head_; node; node = node->next)
+  {
+    if (rhs.inline_.owns(node))
+    {
+      LNode *newNode = inline_.take();
+      newNode->count = node->count;
+      newNode->values = newNode->block->values + (node->values - node->block->values);
+      for (int i = 0; i < asize_; i++)
+      {
+        newNode->block->values[i] = std::move(node->block->values[i]);
+      }
+      newNode->prev = node->prev;
+      newNode->next = node->next;
+      (newNode->prev ? newNode->prev->next : head_) = newNode;
+      (newNode->next ? newNode->next->prev : tail_) = newNode;
+      if (gapNode_ == node)
+      {
+        gapNode_ = newNode;
+      }
+      newNode->zone = node->zone;
+      node->zone = nullptr;
+      newNode->dead = node->dead;
+      newNode->deadCount = node->deadCount;
+      node->dead = nullptr;
+      node->deadCount = 0;
+      rhs.inline_.release();
+      break;
+    }
+  }
+
+  rhs.head_ = rhs.tail_ = rhs.spare_ = rhs.gapNode_ = nullptr;
+  rhs.size_ = rhs.nodecount_ = rhs.sparecount_ = rhs.reserved_ = rhs.deadTotal_ = 0;
+  rhs.gapIndex_ = rhs.gapLength_ = 0;
+  rhs.index_ = nullptr;
+  rhs.indexStale_ = false;
+  rhs.unindexed_ = 0;
+  rhs.zones_ = nullptr;
+  rhs.zonesPending_ = false;
+}
+
+// detach
+// Give node a private copy of its storage before it is written, if any other
+// list still refers to the same block
+template<typename T, int Size>
+void Lariat<T, Size>::detach(LNode *node)
+{
+  if (node->block->refs.load(std::memory_order_acquire) == 1)
+  {
+    return;
+  }
+  // The copy keeps the items at the same offset inside the block.
+  LBlock *block = new LBlock();
+  T *values = block->values + frontRoom(node);
+  for (int i = 0, window = windowLength(node); i < window; i++)
+  {
+    values[i] = node->values[i];
+  }
+  releaseBlock(node->block);
+  node->block = block;
+  node->values = values;
+}
+
+// expose
+// Detaches node for a caller that keeps a writable reference or pointer into
+// it. The reference stays valid after the list is copied, so from now on copies
+// get their own copy of the node's items instead of sharing its block.
+template<typename T, int Size>
+void Lariat<T, Size>::expose(LNode *node)
+{
+  detach(node);
+  node->exposed = true;
+}
+
+// freeNode
+// Disposes of a node that is no longer linked into the list. It is kept as a
+// spare while the list holds fewer nodes than were reserved.
+template<typename T, int Size>
+void Lariat<T, Size>::freeNode(LNode *node)
+{
+  if (node->unindexed)
+  {
+    node->unindexed = false;
+    unindexed_--;
+  }
+  if (node->zone)
+  {
+    zones_->destroy(node->zone);
+    node->zone = nullptr;
+  }
+  deadTotal_ -= static_cast<size_t>(node->deadCount);
+  node->deadCount = 0;
+  delete[] node->dead;
+  node->dead = nullptr;
+  if (inline_.owns(node))
+  {
+    inline_.release();
+    return;
+  }
+  if (nodecount_ + sparecount_ < keptNodes())
+  {
+    if (node->block->refs.load(std::memory_order_acquire) != 1)
+    {
+      releaseBlock(node->block);
+      node->block = new LBlock();
+    }
+    node->prev = nullptr;
+    node->next = spare_;
+    spare_ = node;
+    sparecount_++;
+    return;
+  }
+  releaseBlock(node->block);
+  delete node;
+}
+
+template<typename T, int Size>
+void Lariat<T, Size>::releaseBlock(LBlock *block)
+{
+  if (block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+  {
+    delete block;
+  }
+}
+
 template<typename T, int Size>
 void Lariat<T, Size>::removeNode(typename Lariat<T, Size>::LNode *node)
 {
+  if (node == gapNode_)
+  {
+    gapNode_ = nullptr;
+  }
   // Removing the only node in the list
   if (!node->next && !node->prev)
   {
-    delete node;
     head_ = nullptr;
     tail_ = nullptr;
     nodecount_ = 0;
+    freeNode(node);
     return;
   }
   // Removing the tail
@@ -733,8 +3393,8 @@ void Lariat<T, Size>::removeNode(typename Lariat<T, Size>::LNode *node)
     LNode *newTail = node->prev;
     newTail->next = nullptr;
     tail_ = newTail;
-    delete node;
     nodecount_--;
+    freeNode(node);
     return;
   }
   // Removing the head
@@ -743,8 +3403,8 @@ void Lariat<T, Size>::removeNode(typename Lariat<T, Size>::LNode *node)
     LNode *newHead = node->next;
     newHead->prev = nullptr;
     head_ = newHead;
-    delete node;
     nodecount_--;
+    freeNode(node);
     return;
   }
 
@@ -754,8 +3414,8 @@ void Lariat<T, Size>::removeNode(typename Lariat<T, Size>::LNode *node)
 
   prevNode->next = nextNode;
   nextNode->prev = prevNode;
-  delete node;
   nodecount_--;
+  freeNode(node);
 }
 
 template<typename T, int Size>
@@ -769,17 +3429,189 @@ void Lariat<T, Size>::findTail(LNode * node)
   tail_ = temp;
 }
 
+/*******************************************************************************
+================================ Text Output ===================================
+*******************************************************************************/
+
+// Formatting helpers for dump. Arithmetic values are appended to a plain
+// character buffer; anything else reports that it has to go through the
+// stream's own operator<<. The buffer only reproduces a stream in its default
+// state, so with other flags or locale everything goes through the stream.
+namespace LariatText
+{
+  enum Kind { STREAM, SIGNED, UNSIGNED, FLOATING, CHARACTER };
+
+  template<typename V>
+  struct KindOf
+  {
+    static const Kind value =
+      std::is_floating_point<V>::value ? FLOATING :
+      (std::is_same<V, char>::value || std::is_same<V, signed char>::value ||
+       std::is_same<V, unsigned char>::value) ? CHARACTER :
+      std::is_integral<V>::value ? (std::is_signed<V>::value ? SIGNED : UNSIGNED) :
+      STREAM;
+  };
+
+  inline void appendUnsigned(std::string &buf, unsigned long long value)
+  {
+    char digits[24];
+    int n = 0;
+    do
+    {
+      digits[n++] = static_cast<char>('0' + value % 10);
+      value /= 10;
+    } while (value);
+    while (n)
+    {
+      buf += digits[--n];
+    }
+  }
+
+  inline void appendSigned(std::string &buf, long long value)
+  {
+    if (value < 0)
+    {
+      buf += '-';
+      appendUnsigned(buf, 0ULL - static_cast<unsigned long long>(value));
+      return;
+    }
+    appendUnsigned(buf, static_cast<unsigned long long>(value));
+  }
+
+  template<typename V, Kind K = KindOf<V>::value>
+  struct Format
+  {
+    static bool append(std::string &, const V &, int) { return false; }
+  };
+
+  template<typename V>
+  struct Format<V, SIGNED>
+  {
+    static bool append(std::string &buf, const V &value, int)
+    {
+      appendSigned(buf, static_cast<long long>(value));
+      return true;
+    }
+  };
+
+  template<typename V>
+  struct Format<V, UNSIGNED>
+  {
+    static bool append(std::string &buf, const V &value, int)
+    {
+      appendUnsigned(buf, static_cast<unsigned long long>(value));
+      return true;
+    }
+  };
+
+  template<typename V>
+  struct Format<V, CHARACTER>
+  {
+    static bool append(std::string &buf, const V &value, int)
+    {
+      buf += static_cast<char>(value);
+      return true;
+    }
+  };
+
+  // Same digits the stream would produce with its default (general) format
+  template<typename V>
+  struct Format<V, FLOATING>
+  {
+    static bool append(std::string &buf, const V &value, int precision)
+    {
+      char text[64];
+      int n = std::snprintf(text, sizeof(text), "%.*Lg", precision, static_cast<long double>(value));
+      buf.append(text, static_cast<size_t>(n));
+      return true;
+    }
+  };
+
+  inline bool plain(const std::ostream &os)
+  {
+    return os.flags() == (std::ios_base::skipws | std::ios_base::dec) &&
+           os.getloc() == std::locale::classic();
+  }
+
+  // appends value to buf, or writes out buf and then value through the stream
+  template<typename V>
+  inline void put(std::ostream &os, std::string &buf, const V &value, bool plain, int precision)
+  {
+    if (plain && Format<V>::append(buf, value, precision))
+    {
+      return;
+    }
+    os.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+    buf.clear();
+    os << value;
+  }
+}
+
+// dump
+template<typename T, int Size>
+void Lariat<T, Size>::dump(std::ostream & os, DumpFormat format) const
+{
+  // Everything is formatted into one buffer that is handed to the stream in
+  // large writes, instead of a formatted insertion (and, in operator<<, a
+  // flush) per element.
+  const size_t flushAt = 1 << 16;
+  std::string buf;
+  buf.reserve(flushAt + 256);
+  int precision = static_cast<int>(os.precision());
+  bool plain = LariatText::plain(os);
+
+  if (format == DUMP_CSV)
+  {
+    buf += "index,value\n";
+  }
+  unsigned long long index = 0;
+  for (LNode *node = head_; node; node = node->next)
+  {
+    if (format == DUMP_NODES)
+    {
+      buf += "Node starting (count ";
+      LariatText::put(os, buf, node->count, plain, precision);
+      buf += ")\n";
+    }
+    for (int i = 0; i < node->count; i++, index++)
+    {
+      if (format == DUMP_NODES)
+      {
+        LariatText::put(os, buf, index, plain, precision);
+        buf += " -> ";
+      }
+      else if (format == DUMP_CSV)
+      {
+        LariatText::put(os, buf, index, plain, precision);
+        buf += ',';
+      }
+      LariatText::put(os, buf, node->values[slot(node, i)], plain, precision);
+      buf += '\n';
+    }
+    if (format == DUMP_NODES)
+    {
+      buf += "-----------\n";
+    }
+    if (buf.size() >= flushAt)
+    {
+      os.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+      buf.clear();
+    }
+  }
+  os.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+}
+
 template <typename T, int Size>
 std::ostream& operator<<(std::ostream &os, Lariat<T, Size> const & list)
 {
   typename Lariat<T, Size>::LNode * current = list.head_;
-  int index = 0;
+  size_t index = 0;
   while (current)
   {
     os << "Node starting (count " << current->count << ")\n";
     for (int local_index = 0; local_index < current->count; ++local_index)
     {
-      os << index << " -> " << current->values[local_index] << std::endl;
+      os << index << " -> " << current->values[list.slot(current, local_index)] << '\n';
       ++index;
     }
     os << "-----------\n";
@@ -6,6 +6,13 @@
 #include <string>     // error strings
 #include <utility>    // error strings
 #include <cstring>     // memcpy
+#include <atomic>      // shared block reference counts
+#include <cstddef>     // std::ptrdiff_t
+#include <iterator>    // std::forward_iterator_tag
+#include <type_traits> // std::conditional
+#include <functional>  // std::hash
+#include <cstdint>     // dead slot bitmaps
+#include <vector>      // apply_batch
 
 class LariatException : public std::exception {
 private:
@@ -30,6 +37,13 @@ public:
   enum LARIAT_EXCEPTION { E_NO_MEMORY, E_BAD_INDEX, E_DATA_ERROR };
 };
 
+// Lists whose node storage (sizeof(T) * Size) fits in this many bytes keep
+// their first node inside the Lariat object itself, so a small list never
+// allocates. Define as 0 to turn it off.
+#ifndef LARIAT_INLINE_BYTES
+#define LARIAT_INLINE_BYTES 256
+#endif
+
 // forward declaration for 1-1 operator<< 
 template<typename T, int Size>
 class Lariat;
@@ -43,7 +57,10 @@ class Lariat
 public:
 
   Lariat();                  // default constructor                        
-  Lariat(Lariat const& rhs); // copy constructor
+  Lariat(Lariat const& rhs); // copy constructor, shares node storage (copy-on-write)
+                             // except for nodes a writable reference or
+                             // segment pointer was taken into, which are copied
+  Lariat(Lariat &&rhs) noexcept(std::is_nothrow_move_assignable<T>::value); // leaves rhs empty
 
 
   template<typename L, int NewSize>
@@ -53,48 +70,212 @@ public:
   // more ctor(s) and assignment(s)
 
   Lariat &operator=(const Lariat &rhs);
+  Lariat &operator=(Lariat &&rhs) noexcept(std::is_nothrow_move_assignable<T>::value);
 
   template<typename L, int NewSize>
   Lariat &operator=(const Lariat<L, NewSize> &rhs);
 
   // inserts
-  void insert(int index, const T& value);
+  void insert(size_t index, const T& value);
   void push_back(const T& value);
   void push_front(const T& value);
 
   // deletes
-  void erase(int index);
+  void erase(size_t index);
   void pop_back();
   void pop_front();
 
   //access
-  T&       operator[](int index);       // for l-values
-  const T& operator[](int index) const; // for r-values
+  T&       operator[](size_t index);       // for l-values
+  const T& operator[](size_t index) const; // for r-values
   T&       first();
   T const& first() const;
   T&       last();
   T const& last() const;
 
-  unsigned find(const T& value) const;       // returns index, size (one past last) if not found
+  size_t find(const T& value) const;         // returns index, size (one past last) if not found
+  size_t find(const T& value);               // the same, see enable_index for the difference
+
+  // text editing, Lariat<char, Size> only (erase of a range works for any T):
+    // each call walks to the position once and then copies whole runs of a
+    // node with memcpy, so it costs O(n/Size + length); text find matches
+    // across node boundaries and returns size() if not found
+  template<typename C = T>
+  void insert(size_t index, const C *text, size_t length);
+  template<typename C = T>
+  void insert(size_t index, const std::basic_string<C> &text);
+  void erase(size_t index, size_t length);
+  template<typename C = T>
+  std::basic_string<C> substr(size_t index, size_t length) const;
+  template<typename C = T>
+  size_t find(const C *text, size_t length) const;
+  template<typename C = T>
+  size_t find(const std::basic_string<C> &text) const;
+
+  // batched edits: every index is a position in the list as it was before
+    // the batch; an insert goes in front of the item at its index (size()
+    // appends) and inserts at the same index keep their order. The ops are
+    // sorted and applied in one pass, each node they touch is rewritten once.
+    // Throws E_BAD_INDEX, leaving the list unchanged, for an index out of
+    // range or an item erased twice.
+  struct BatchOp {
+    enum Kind { INSERT, ERASE };
+    Kind   kind;
+    size_t index;
+    T      value;  // INSERT only
+  };
+  void apply_batch(const std::vector<BatchOp> &ops);
+
+  // value index: an optional hash table from value to the nodes holding it,
+    // so find only walks node counts and scans one node. insert/erase/push/pop
+    // and compact keep it current. operator[], first and last take the items
+    // of the node they return into out of the index (O(Size) the first time a
+    // node is handed out) and the next find or count on a non-const list puts
+    // them back; segments, for_each, transform, sort and load mark it stale
+    // and the next such query rebuilds it in O(n). The const queries never
+    // change the list: they scan the nodes out of the index as well, or the
+    // whole list while it is stale, so they may run on several threads at
+    // once as long as nothing writes to the list. Costs roughly one hash
+    // entry per distinct value per node.
+  template<typename Hash = std::hash<T> >
+  void enable_index();
+  void disable_index();
+  bool indexed() const;
+
+  // zone maps: a small summary per node that lets find, count and the range
+    // queries skip nodes that can't hold a match. MinMax keeps the smallest
+    // and largest item (T needs operator<), Bloom a 64 bit bloom filter of
+    // Hash values. Inserts, split, compact and rebalance widen the summaries
+    // and erases leave them as they are. operator[], first and last mark the
+    // summary of their node stale, segments, for_each, transform, sort and
+    // load all of them, and the next query on a non-const list summarises
+    // those nodes again. The const queries look into every node without a
+    // current summary, as they do with the index.
+  template<bool MinMax = true, bool Bloom = false, typename Hash = std::hash<T> >
+  void enable_zone_maps();
+  void disable_zone_maps();
+  bool zone_mapped() const;
+
+  size_t count(const T& value) const;                    // items equal to value
+  size_t count_range(const T& low, const T& high) const; // items with low <= item <= high
+  size_t find_range(const T& low, const T& high) const;  // first such item, size() if none
+  size_t count(const T& value);
+  size_t count_range(const T& low, const T& high);
+  size_t find_range(const T& low, const T& high);
 
   friend std::ostream& operator<< <T, Size>(std::ostream &os, Lariat<T, Size> const & list);
 
+  enum DumpFormat
+  {
+    DUMP_NODES, // same text as operator<<
+    DUMP_LINES, // one value per line
+    DUMP_CSV,   // "index,value" rows under a header line
+  };
+  // buffered bulk output, arithmetic T is formatted without going through the
+  // stream as long as the stream has its default flags and the classic locale
+  void dump(std::ostream &os, DumpFormat format = DUMP_NODES) const;
+
   // and some more
   size_t size(void) const;   // total number of items (not nodes)
   void clear(void);          // make it empty
 
   void compact();             // push data in front reusing empty positions and delete remaining nodes
+  void rebalance(double target_fill); // repack so each node holds about target_fill * Size items
+
+  // node preallocation: a split leaves both nodes at least half full, so
+    // reserve keeps n / (Size / 2) nodes (in the list or spare), which take n
+    // items pushed or inserted without allocating; split/push_* use spares
+    // first. After erases have thinned out nodes that is no longer a bound.
+  void reserve(size_t n);
+  size_t capacity() const;    // item slots in the list's nodes plus the spare nodes (about 2n after reserve(n))
+  void shrink_to_fit();       // compact, then free the spare nodes
+
+  // gap buffer mode: insert/erase inside a node leave a gap at the edit
+    // position, so further edits nearby only move the gap boundary
+  void set_gap_buffer(bool enable);
+  bool gap_buffer() const;
+
+  // lazy erase mode: erase inside a node only marks the item dead; a node's
+    // dead slots are squeezed out the next time it is written, and all of
+    // them before compact, sort and the other non-const passes over the
+    // whole list. Const members step over dead slots and never move items.
+    // Turning either this or gap buffer mode on turns the other one off.
+  void set_lazy_erase(bool enable);
+  bool lazy_erase() const;
+
+  // bounded mode (sliding window): at most n items are kept. On a full list
+    // push_back (and insert at size()) drops the first item and push_front
+    // (and insert at 0) the last one; any other insert, a text insert or an
+    // apply_batch that would go past n throws E_NO_MEMORY and changes
+    // nothing. set_max_size and load keep the last n items. push_back fills
+    // whole nodes and emptied nodes are kept as spares for new ones, so a
+    // full window runs without allocating; shrink_to_fit frees those spares
+    // too. 0 turns it off and frees the spares reserve didn't ask for.
+  void set_max_size(size_t n);
+  size_t max_size() const;
+
+  // segmented access: each node's elements as one contiguous span (more for
+    // a node holding the gap or dead slots when iterating a const list)
+  template<typename V>
+  struct Segment {
+    V  *data;
+    int count;
+    V *begin() const { return data; }
+    V *end() const   { return data + count; }
+  };
+  template<typename V>
+  class SegmentRange;
+  SegmentRange<T>       segments();       // writable spans, unshares nodes as visited
+  SegmentRange<const T> segments() const;
+
+  // bulk algorithms, each node's values are processed as one contiguous run
+    // threads: 0 = one per hardware thread; the list is cut into that many
+    // segments of roughly equal element count, f/op must not modify the list
+  template<typename F>
+  void for_each(F f, unsigned threads = 1);          // f(T&)
+  template<typename F>
+  void for_each(F f, unsigned threads = 1) const;    // f(const T&)
+  template<typename F>
+  void transform(F f, unsigned threads = 1);         // value = f(value)
+  template<typename R, typename Op>
+  R reduce(R init, Op op, unsigned threads = 1) const; // op must be associative
+
+  // sorting: every node is sorted on its own, then the sorted nodes are
+    // merged pairwise into densely packed nodes, reusing the drained ones.
+    // threads: 0 = one per hardware thread, as for the bulk algorithms; comp
+    // is called from all of them at once
+  void sort();
+  template<typename Compare>
+  void sort(Compare comp, unsigned threads = 0);
+  void stable_sort();
+  template<typename Compare>
+  void stable_sort(Compare comp, unsigned threads = 0);
+
+  // binary persistence (trivially copyable T only)
+  void save(std::ostream &os) const; // versioned header, then the elements node by node
+  void load(std::istream &is);       // replaces the contents, packing nodes densely
 
 private:
   template<typename L, int NewSize>
   friend class Lariat;
 
-  struct LNode { // DO NOT modify provided code
-    LNode *next = nullptr;
-    LNode *prev = nullptr;
-    int    count = 0;         // number of items currently in the node
+  struct LBlock { // node storage, shared between copies until written
+    std::atomic<int> refs{1};
     T values[Size];
   };
+  struct LZone;            // zone map summary, see enable_zone_maps
+  struct LNode {
+    LNode  *next = nullptr;
+    LNode  *prev = nullptr;
+    int     count = 0;        // number of items currently in the node
+    LBlock *block = nullptr;
+    T      *values = nullptr; // first item, somewhere inside block->values
+    int       deadCount = 0;  // lazy erase: dead slots among the items
+    uint64_t *dead = nullptr; // one bit per slot from values on, set if dead
+    LZone    *zone = nullptr; // zone map summary, null until a query builds it
+    bool      exposed = false; // a writable reference into block was handed out
+    bool      unindexed = false; // items are out of index_ until refreshIndex
+  };
   struct IndexedNode
   {
     LNode *node = nullptr;
@@ -105,25 +286,193 @@ private:
     TOPHEAVY,
     BOTTOMHEAVY,
   };
+  // the node kept inside the object (see LARIAT_INLINE_BYTES); it is used
+    // before any spare or new node and is never shared with a copy
+  template<bool Enabled, typename Unused = void>
+  struct InlineSlot
+  {
+    LNode  node;
+    LBlock block;
+    bool   used = false;
+    LNode *take()                        { if (used) return nullptr; used = true; node = LNode(); node.block = &block; return &node; }
+    bool   owns(const LNode *n) const    { return n == &node; }
+    bool   available() const             { return !used; }
+    void   release()                     { used = false; }
+  };
+  template<typename Unused>
+  struct InlineSlot<false, Unused>
+  {
+    LNode *take()                        { return nullptr; }
+    bool   owns(const LNode *) const     { return false; }
+    bool   available() const             { return false; }
+    void   release()                     {}
+  };
+  struct LIndex;          // value index interface, see enable_index
+  template<typename Hash>
+  struct LHashIndex;
+  struct LZoneMap;        // zone map interface, see enable_zone_maps
+  template<bool MinMax, bool Bloom, typename Hash>
+  struct LZoneMapImpl;
+public:
+  // defined here rather than above because it walks LNodes
+  template<typename V>
+  class SegmentRange
+  {
+    typedef typename std::conditional<std::is_const<V>::value, const Lariat, Lariat>::type Owner;
+  public:
+    class iterator
+    {
+    public:
+      typedef std::forward_iterator_tag iterator_category;
+      typedef Segment<V>                value_type;
+      typedef std::ptrdiff_t            difference_type;
+      typedef const Segment<V>         *pointer;
+      typedef Segment<V>                reference;
+
+      iterator(Owner *list, LNode *node) : list_(list), node_(node), offset_(0) { skipEmpty(); }
+      Segment<V> operator*() const
+      {
+        Segment<V> segment = { data(list_, node_) + list_->slot(node_, offset_), list_->contiguous(node_, offset_) };
+        return segment;
+      }
+      iterator &operator++()    { offset_ += list_->contiguous(node_, offset_); skipEmpty(); return *this; }
+      iterator operator++(int)  { iterator old(*this); ++*this; return old; }
+      bool operator==(iterator const &rhs) const { return node_ == rhs.node_ && offset_ == rhs.offset_; }
+      bool operator!=(iterator const &rhs) const { return !(*this == rhs); }
+    private:
+      Owner *list_;
+      LNode *node_;
+      int    offset_;           // item of node_ the segment starts at
+      void skipEmpty()
+      {
+        while (node_ && offset_ == node_->count)
+        {
+          node_ = node_->next;
+          offset_ = 0;
+        }
+      }
+      static T *data(Lariat *list, LNode *node)             { list->expose(node); return node->values; }
+      static const T *data(const Lariat *, LNode *node)    { return node->values; }
+    };
+
+    explicit SegmentRange(Owner *list) : list_(list) {}
+    iterator begin() const { return iterator(list_, list_->head_); }
+    iterator end() const   { return iterator(list_, nullptr); }
+  private:
+    Owner *list_;
+  };
+
+private:
   // DO NOT modify provided code
   LNode *head_;           // points to the first node
   LNode *tail_;           // points to the last node
-  int size_;              // the number of items (not nodes) in the list
-  mutable int nodecount_; // the number of nodes in the list
+  size_t size_;              // the number of items (not nodes) in the list
+  mutable size_t nodecount_; // the number of nodes in the list
   int asize_;             // the size of the array within the nodes
 
+  LNode *spare_;          // unused nodes, linked through next
+  size_t sparecount_;
+  size_t reserved_;       // nodes (in the list or spare) reserve asked to keep allocated
+
+  InlineSlot<sizeof(T) * Size <= LARIAT_INLINE_BYTES> inline_;
+
+  bool   gapMode_;        // set_gap_buffer
+  LNode *gapNode_;        // the node holding the gap, if any
+  int    gapIndex_;       // items [gapIndex_, count) sit gapLength_ slots further up
+  int    gapLength_;
+
+  bool   lazyErase_;      // set_lazy_erase
+  size_t deadTotal_;      // dead slots over all nodes
+
+  size_t maxSize_;        // set_max_size, 0 when unbounded
+
+  LIndex        *index_;      // enable_index, null when off
+  bool           indexStale_; // index_ must be rebuilt before it is used
+  size_t         unindexed_;  // nodes whose items are out of index_
+
+  LZoneMap      *zones_;        // enable_zone_maps, null when off
+  unsigned long  zoneStamp_;    // summaries carrying another stamp are stale
+  bool           zonesPending_; // some node may lack a current summary
+
   //Recommended Helper Functions
     // split
   void split(LNode *node, SplitType type = BOTTOMHEAVY);
     // findElement
-  IndexedNode findElement(int index) const;
+  IndexedNode findElement(size_t index) const;
     // shiftUp
   void shiftUp(LNode *node, int index);
     // shiftDown
   void shiftDown(LNode *node, int index = 0);
 
+  // free slots before the first and after the last item of a node
+  int frontRoom(const LNode *node) const;
+  int backRoom(const LNode *node) const;
+  void slide(LNode *node, int start);
+
+  // gap buffer
+  int slot(const LNode *node, int index) const; // values[] offset of an item
+  int contiguous(const LNode *node, int index) const; // items in one run from index on
+  int windowLength(const LNode *node) const;    // items plus gap
+  void closeGap();
+  void moveGap(int index);
+  void gapInsert(LNode *node, int index, const T& value);
+  void gapErase(LNode *node, int index);
+
+  // lazy erase
+  int liveSlot(const LNode *node, int index) const; // values[] offset of the index'th live item
+  void lazyErase(LNode *node, int index);
+  void settleNode(LNode *node);
+  void settle();
+  void copyDead(LNode *to, const LNode *from); // to gets its own copy of from's bitmap
+
+  void evictFront();        // bounded mode: pop_front down to maxSize_
+  size_t keptNodes() const; // reserved_, or more for a bounded list
+  void fitSpares();         // frees spares beyond keptNodes, allocates up to reserved_
+
+  // text editing
+  template<typename C>
+  LNode *fillText(LNode *node, const C *text, size_t length);
+  template<typename C>
+  bool matchText(const LNode *node, int offset, const C *text, size_t length) const;
+
+  // value index upkeep, all no-ops while the index is off
+  void indexAdd(const LNode *node, const T& value);
+  void indexRemove(const LNode *node, const T& value);
+  void indexMove(const LNode *from, const LNode *to, const T& value);
+  void markIndexStale();
+  void indexForget(LNode *node);   // node's items may be rewritten through a reference
+  void refreshIndex();
+  void rebuildIndex();
+
+  // zone map upkeep, all no-ops while zone maps are off
+  void zoneAdd(LNode *node, const T& value);
+  void zoneMerge(LNode *to, const LNode *from); // to takes over from's items
+  void zoneReset(LNode *node);                  // node was emptied
+  void zoneDirty(LNode *node);                  // node's items were rewritten
+  void markZonesStale();
+  const LZone *zoneOf(const LNode *node) const; // null unless current
+  void refreshZones();
+  void prepareQuery(); // refreshIndex and refreshZones
+
   // My helper functions
+  template<typename Work>
+  unsigned forSegments(unsigned threads, Work work) const;
+  template<typename Compare>
+  void sortNodes(Compare comp, unsigned threads, bool stable);
+  struct LRun;   // sorted chain of nodes
+  struct LMerge; // result of mergeRuns
+  template<typename Compare>
+  void mergeRuns(LRun left, LRun right, Compare &comp, LMerge &merge);
   LNode *makeNode();
+  LNode *appendNode();
+  LNode *linkAfter(LNode *node);
+  LNode *shareNode(LNode *node);
+  LNode *copyNode(const LNode *node);
+  void steal(Lariat &rhs);
+  void detach(LNode *node);
+  void expose(LNode *node);
+  void releaseBlock(LBlock *block);
+  void freeNode(LNode *node);
   void removeNode(LNode *node);
   void findTail(LNode *node);
 };
@@ -0,0 +1,506 @@
+#include <cstring>      // memcmp, memcpy, memmove
+#include <type_traits>  // std::is_trivially_copyable
+#include <fcntl.h>      // open
+#include <unistd.h>     // close, ftruncate
+#include <sys/mman.h>   // mmap, msync, munmap
+#include <sys/stat.h>   // fstat
+#include "lariat_file.h"
+
+namespace LariatFileFormat
+{
+  const char     magic[4] = { 'L', 'R', 'F', 'B' };
+  const uint32_t version = 1;
+  const uint64_t initialBlocks = 16;
+}
+
+/*******************************************************************************
+========================= Constructors and Destructor ==========================
+*******************************************************************************/
+
+template<typename T, int Size>
+LariatFile<T, Size>::LariatFile() : fd_(-1), base_(nullptr), mapped_(0)
+{
+  static_assert(std::is_trivially_copyable<T>::value,
+                "LariatFile requires a trivially copyable element type");
+}
+
+template<typename T, int Size>
+LariatFile<T, Size>::LariatFile(const std::string & path) : LariatFile()
+{
+  open(path);
+}
+
+template<typename T, int Size>
+LariatFile<T, Size>::~LariatFile()
+{
+  close();
+}
+
+/*******************************************************************************
+================================ File Control ==================================
+*******************************************************************************/
+
+// open
+template<typename T, int Size>
+void LariatFile<T, Size>::open(const std::string & path)
+{
+  close();
+  fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd_ < 0)
+  {
+    throw LariatException(LariatException::E_DATA_ERROR, "Cannot open " + path);
+  }
+
+  struct stat st;
+  if (fstat(fd_, &st) != 0)
+  {
+    close();
+    throw LariatException(LariatException::E_DATA_ERROR, "Cannot stat " + path);
+  }
+
+  // A new file gets a header and a handful of blocks; an existing one has to
+  // have been written by the same element type and node size.
+  if (st.st_size == 0)
+  {
+    size_t bytes = blockSize_ * LariatFileFormat::initialBlocks;
+    if (ftruncate(fd_, static_cast<off_t>(bytes)) != 0)
+    {
+      close();
+      throw LariatException(LariatException::E_NO_MEMORY, "Cannot size " + path);
+    }
+    map(bytes);
+    FHeader *h = header();
+    std::memcpy(h->magic, LariatFileFormat::magic, sizeof(h->magic));
+    h->version = LariatFileFormat::version;
+    h->elementSize = sizeof(T);
+    h->nodeSize = Size;
+    h->blockCount = LariatFileFormat::initialBlocks;
+    h->blocksUsed = 1;
+    h->head = h->tail = h->freeList = 0;
+    h->size = h->nodecount = 0;
+    return;
+  }
+
+  if (static_cast<size_t>(st.st_size) < blockSize_)
+  {
+    close();
+    throw LariatException(LariatException::E_DATA_ERROR, "Not a lariat file: " + path);
+  }
+  map(static_cast<size_t>(st.st_size));
+  FHeader *h = header();
+  if (std::memcmp(h->magic, LariatFileFormat::magic, sizeof(h->magic)) != 0 ||
+      h->version != LariatFileFormat::version ||
+      h->elementSize != sizeof(T) || h->nodeSize != static_cast<uint32_t>(Size) ||
+      h->blockCount == 0 || h->blockCount * blockSize_ > mapped_)
+  {
+    close();
+    throw LariatException(LariatException::E_DATA_ERROR, "Incompatible lariat file: " + path);
+  }
+
+  // A grow that was cut short leaves the file longer than the header says;
+  // those blocks were never handed out, so the file is cut back to them.
+  size_t bytes = static_cast<size_t>(h->blockCount) * blockSize_;
+  if (bytes < mapped_)
+  {
+    munmap(base_, mapped_);
+    base_ = nullptr;
+    if (ftruncate(fd_, static_cast<off_t>(bytes)) != 0)
+    {
+      close();
+      throw LariatException(LariatException::E_DATA_ERROR, "Cannot size " + path);
+    }
+    map(bytes);
+  }
+}
+
+// close
+template<typename T, int Size>
+void LariatFile<T, Size>::close()
+{
+  // The mapping is shared, so the kernel writes dirty pages back on its own;
+  // call sync() first if they have to be on disk right now.
+  if (base_)
+  {
+    munmap(base_, mapped_);
+    base_ = nullptr;
+    mapped_ = 0;
+  }
+  if (fd_ >= 0)
+  {
+    ::close(fd_);
+    fd_ = -1;
+  }
+}
+
+// sync
+template<typename T, int Size>
+void LariatFile<T, Size>::sync()
+{
+  checkOpen();
+  if (msync(base_, mapped_, MS_SYNC) != 0)
+  {
+    throw LariatException(LariatException::E_DATA_ERROR, "msync failed");
+  }
+}
+
+template<typename T, int Size>
+bool LariatFile<T, Size>::is_open() const
+{
+  return base_ != nullptr;
+}
+
+/*******************************************************************************
+============================== Element Addition ================================
+*******************************************************************************/
+
+// insert
+template<typename T, int Size>
+void LariatFile<T, Size>::insert(size_t index, const T & value)
+{
+  checkOpen();
+  if (index > header()->size)
+  {
+    throw LariatException(LariatException::E_BAD_INDEX, "Subscript is out of range");
+  }
+
+  // Appending and prepending start a fresh block instead of splitting a full
+  // end block in half, so sequential fills leave the file densely packed.
+  Block block;
+  size_t local;
+  if (index == header()->size)
+  {
+    block = header()->tail;
+    if (!block || node(block)->count == static_cast<uint64_t>(Size))
+    {
+      block = linkAfter(block);
+    }
+    local = node(block)->count;
+  }
+  else if (index == 0 && node(header()->head)->count == static_cast<uint64_t>(Size))
+  {
+    block = linkAfter(0);
+    local = 0;
+  }
+  else
+  {
+    IndexedBlock ib = findElement(index);
+    block = ib.block;
+    local = ib.index;
+    if (node(block)->count == static_cast<uint64_t>(Size))
+    {
+      split(block);
+      size_t kept = node(block)->count;
+      if (local > kept)
+      {
+        local -= kept;
+        block = node(block)->next;
+      }
+    }
+  }
+
+  FNode *n = node(block);
+  std::memmove(n->values + local + 1, n->values + local, sizeof(T) * (n->count - local));
+  n->values[local] = value;
+  n->count++;
+  header()->size++;
+}
+
+template<typename T, int Size>
+void LariatFile<T, Size>::push_back(const T & value)
+{
+  checkOpen();
+  insert(header()->size, value);
+}
+
+template<typename T, int Size>
+void LariatFile<T, Size>::push_front(const T & value)
+{
+  insert(0, value);
+}
+
+/*******************************************************************************
+=============================== Element Removal ================================
+*******************************************************************************/
+
+// erase
+template<typename T, int Size>
+void LariatFile<T, Size>::erase(size_t index)
+{
+  checkOpen();
+  if (index >= header()->size)
+  {
+    throw LariatException(LariatException::E_BAD_INDEX, "Subscript is out of range");
+  }
+  IndexedBlock ib = findElement(index);
+  FNode *n = node(ib.block);
+  std::memmove(n->values + ib.index, n->values + ib.index + 1, sizeof(T) * (n->count - ib.index - 1));
+  n->count--;
+  header()->size--;
+  if (n->count == 0)
+  {
+    unlink(ib.block);
+  }
+}
+
+template<typename T, int Size>
+void LariatFile<T, Size>::pop_back()
+{
+  checkOpen();
+  erase(header()->size - 1);
+}
+
+template<typename T, int Size>
+void LariatFile<T, Size>::pop_front()
+{
+  erase(0);
+}
+
+/*******************************************************************************
+================================ Element Access ================================
+*******************************************************************************/
+
+template<typename T, int Size>
+T & LariatFile<T, Size>::operator[](size_t index)
+{
+  IndexedBlock ib = findElement(index);
+  return node(ib.block)->values[ib.index];
+}
+
+template<typename T, int Size>
+const T & LariatFile<T, Size>::operator[](size_t index) const
+{
+  IndexedBlock ib = findElement(index);
+  return node(ib.block)->values[ib.index];
+}
+
+/*******************************************************************************
+========================== Data Structure Information ==========================
+*******************************************************************************/
+
+template<typename T, int Size>
+size_t LariatFile<T, Size>::size(void) const
+{
+  return base_ ? static_cast<size_t>(header()->size) : 0;
+}
+
+template<typename T, int Size>
+size_t LariatFile<T, Size>::nodes(void) const
+{
+  return base_ ? static_cast<size_t>(header()->nodecount) : 0;
+}
+
+template<typename T, int Size>
+size_t LariatFile<T, Size>::capacity(void) const
+{
+  return base_ ? static_cast<size_t>(header()->blockCount - 1) : 0;
+}
+
+// clear
+template<typename T, int Size>
+void LariatFile<T, Size>::clear(void)
+{
+  // The file keeps its size; every block goes back on the free list.
+  checkOpen();
+  while (header()->head)
+  {
+    unlink(header()->head);
+  }
+  header()->size = 0;
+}
+
+/*******************************************************************************
+============================== Helper Functions ================================
+*******************************************************************************/
+
+template<typename T, int Size>
+typename LariatFile<T, Size>::FHeader * LariatFile<T, Size>::header() const
+{
+  return reinterpret_cast<FHeader *>(base_);
+}
+
+template<typename T, int Size>
+typename LariatFile<T, Size>::FNode * LariatFile<T, Size>::node(Block block) const
+{
+  return reinterpret_cast<FNode *>(base_ + block * blockSize_);
+}
+
+template<typename T, int Size>
+void LariatFile<T, Size>::map(size_t bytes)
+{
+  void *addr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (addr == MAP_FAILED)
+  {
+    close();
+    throw LariatException(LariatException::E_NO_MEMORY, "mmap failed");
+  }
+  base_ = static_cast<char *>(addr);
+  mapped_ = bytes;
+}
+
+// grow
+// Doubles the file. Every FNode pointer taken before this call is invalid
+// afterwards, which is why everything else holds on to block numbers. The
+// header is only updated once the blocks exist, so it never claims more than
+// the file holds; open() trims a file that grew without its header catching up.
+template<typename T, int Size>
+void LariatFile<T, Size>::grow()
+{
+  uint64_t blocks = header()->blockCount * 2;
+  size_t bytes = static_cast<size_t>(blocks) * blockSize_;
+  munmap(base_, mapped_);
+  base_ = nullptr;
+  if (ftruncate(fd_, static_cast<off_t>(bytes)) != 0)
+  {
+    map(mapped_);
+    throw LariatException(LariatException::E_NO_MEMORY, "Cannot grow lariat file");
+  }
+  map(bytes);
+  header()->blockCount = blocks;
+}
+
+template<typename T, int Size>
+typename LariatFile<T, Size>::Block LariatFile<T, Size>::allocBlock()
+{
+  Block block = header()->freeList;
+  if (block)
+  {
+    header()->freeList = node(block)->next;
+  }
+  else
+  {
+    if (header()->blocksUsed == header()->blockCount)
+    {
+      grow();
+    }
+    block = header()->blocksUsed++;
+  }
+  FNode *n = node(block);
+  n->next = n->prev = 0;
+  n->count = 0;
+  header()->nodecount++;
+
+  return block;
+}
+
+template<typename T, int Size>
+void LariatFile<T, Size>::freeBlock(Block block)
+{
+  node(block)->next = header()->freeList;
+  header()->freeList = block;
+  header()->nodecount--;
+}
+
+// linkAfter
+template<typename T, int Size>
+typename LariatFile<T, Size>::Block LariatFile<T, Size>::linkAfter(Block block)
+{
+  Block newBlock = allocBlock();
+  FHeader *h = header();
+  FNode *n = node(newBlock);
+  Block next = block ? node(block)->next : h->head;
+  n->prev = block;
+  n->next = next;
+  if (block)
+  {
+    node(block)->next = newBlock;
+  }
+  else
+  {
+    h->head = newBlock;
+  }
+  if (next)
+  {
+    node(next)->prev = newBlock;
+  }
+  else
+  {
+    h->tail = newBlock;
+  }
+
+  return newBlock;
+}
+
+template<typename T, int Size>
+void LariatFile<T, Size>::unlink(Block block)
+{
+  FHeader *h = header();
+  FNode *n = node(block);
+  if (n->prev)
+  {
+    node(n->prev)->next = n->next;
+  }
+  else
+  {
+    h->head = n->next;
+  }
+  if (n->next)
+  {
+    node(n->next)->prev = n->prev;
+  }
+  else
+  {
+    h->tail = n->prev;
+  }
+  freeBlock(block);
+}
+
+// split
+// Moves the upper half of a full block into a new block right after it
+template<typename T, int Size>
+void LariatFile<T, Size>::split(Block block)
+{
+  Block newBlock = linkAfter(block);
+  FNode *n = node(block);
+  FNode *newNode = node(newBlock);
+  uint64_t keep = n->count / 2 + n->count % 2;
+  newNode->count = n->count - keep;
+  std::memcpy(newNode->values, n->values + keep, sizeof(T) * newNode->count);
+  n->count = keep;
+}
+
+// findElement
+template<typename T, int Size>
+typename LariatFile<T, Size>::IndexedBlock LariatFile<T, Size>::findElement(size_t index) const
+{
+  checkOpen();
+  if (index >= header()->size)
+  {
+    throw LariatException(LariatException::E_BAD_INDEX, "Subscript is out of range");
+  }
+  // Walk from whichever end is closer, touching only the block headers.
+  IndexedBlock ib;
+  if (index < header()->size / 2)
+  {
+    Block block = header()->head;
+    while (index >= node(block)->count)
+    {
+      index -= static_cast<size_t>(node(block)->count);
+      block = node(block)->next;
+    }
+    ib.block = block;
+    ib.index = index;
+  }
+  else
+  {
+    size_t fromBack = static_cast<size_t>(header()->size) - index;
+    Block block = header()->tail;
+    while (fromBack > node(block)->count)
+    {
+      fromBack -= static_cast<size_t>(node(block)->count);
+      block = node(block)->prev;
+    }
+    ib.block = block;
+    ib.index = static_cast<size_t>(node(block)->count) - fromBack;
+  }
+
+  return ib;
+}
+
+template<typename T, int Size>
+void LariatFile<T, Size>::checkOpen() const
+{
+  if (!base_)
+  {
+    throw LariatException(LariatException::E_DATA_ERROR, "Lariat file is not open");
+  }
+}
@@ -0,0 +1,101 @@
+////////////////////////////////////////////////////////////////////////////////
+#ifndef LARIAT_FILE_H
+#define LARIAT_FILE_H
+////////////////////////////////////////////////////////////////////////////////
+
+#include <string>     // file path
+#include <cstdint>    // on-disk field widths
+#include "lariat.h"   // LariatException
+
+// A Lariat whose nodes live in fixed size blocks of a memory-mapped file, so
+// the list can be much larger than RAM and survives close/reopen. Blocks link
+// to each other by block number instead of pointer, which keeps the file
+// valid wherever it is mapped. Freed blocks are kept on a free list inside
+// the file and reused before the file grows. POSIX only.
+template <typename T, int Size>
+class LariatFile
+{
+public:
+
+  LariatFile();                                // closed, call open()
+  explicit LariatFile(const std::string &path); // open or create path
+  ~LariatFile();                               // closes, does not sync
+
+  LariatFile(LariatFile const& rhs)            = delete;
+  LariatFile &operator=(LariatFile const& rhs) = delete;
+
+  void open(const std::string &path); // creates the file if it doesn't exist
+  void close();
+  void sync();                        // msync the whole mapping to disk
+  bool is_open() const;
+
+  // inserts
+  void insert(size_t index, const T& value);
+  void push_back(const T& value);
+  void push_front(const T& value);
+
+  // deletes
+  void erase(size_t index);
+  void pop_back();
+  void pop_front();
+
+  //access
+  T&       operator[](size_t index);
+  const T& operator[](size_t index) const;
+
+  size_t size(void) const;
+  size_t nodes(void) const;     // blocks currently holding elements
+  size_t capacity(void) const;  // blocks the file has room for
+  void clear(void);
+
+private:
+  typedef uint64_t Block;       // block number, 0 is the header, so "none"
+
+  struct FHeader {
+    char     magic[4];
+    uint32_t version;
+    uint32_t elementSize;
+    uint32_t nodeSize;
+    uint64_t blockCount;        // blocks in the file, header included
+    uint64_t blocksUsed;        // blocks ever handed out, header included
+    Block    head;
+    Block    tail;
+    Block    freeList;          // singly linked through FNode::next
+    uint64_t size;
+    uint64_t nodecount;
+  };
+  struct FNode {
+    Block    next;
+    Block    prev;
+    uint64_t count;
+    T values[Size];
+  };
+  struct IndexedBlock
+  {
+    Block  block;
+    size_t index;
+  };
+
+  static const size_t blockSize_ =
+    ((sizeof(FNode) > sizeof(FHeader) ? sizeof(FNode) : sizeof(FHeader)) + 63) / 64 * 64;
+
+  int    fd_;                   // -1 when closed
+  char  *base_;                 // start of the mapping
+  size_t mapped_;               // bytes mapped
+
+  FHeader *header() const;
+  FNode   *node(Block block) const;
+  void     map(size_t bytes);
+  void     grow();
+  Block    allocBlock();
+  void     freeBlock(Block block);
+  Block    linkAfter(Block block); // new empty block after block (0 = new head)
+  void     unlink(Block block);
+  void     split(Block block);
+  IndexedBlock findElement(size_t index) const;
+  void     checkOpen() const;
+};
+
+#include "lariat_file.cpp"
+
+#endif // LARIAT_FILE_H
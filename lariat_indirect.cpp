@@ -0,0 +1,322 @@
+#include <new>      // placement new
+#include "lariat_indirect.h"
+
+/*******************************************************************************
+========================= Constructors and Destructor ==========================
+*******************************************************************************/
+
+// Constructor
+template<typename T, int Size>
+LariatIndirect<T, Size>::LariatIndirect() : list_(), chunks_(nullptr), free_(nullptr), slots_(0)
+{
+}
+
+// Copy Constructor
+template<typename T, int Size>
+LariatIndirect<T, Size>::LariatIndirect(LariatIndirect const & rhs)
+  : list_(), chunks_(nullptr), free_(nullptr), slots_(0)
+{
+  try
+  {
+    for (auto segment : static_cast<const Lariat<T *, Size> &>(rhs.list_).segments())
+    {
+      for (T *object : segment)
+      {
+        push_back(*object);
+      }
+    }
+  }
+  catch (...)
+  {
+    clear();
+    throw;
+  }
+}
+
+// Destructor
+template<typename T, int Size>
+LariatIndirect<T, Size>::~LariatIndirect()
+{
+  clear();
+}
+
+// Assignment Operator
+template<typename T, int Size>
+LariatIndirect<T, Size> & LariatIndirect<T, Size>::operator=(LariatIndirect const & rhs)
+{
+  if (this == &rhs)
+  {
+    return *this;
+  }
+  // Keep the slab, the slots of the old elements are reused for the new ones.
+  while (size())
+  {
+    pop_back();
+  }
+  for (auto segment : static_cast<const Lariat<T *, Size> &>(rhs.list_).segments())
+  {
+    for (T *object : segment)
+    {
+      push_back(*object);
+    }
+  }
+  return *this;
+}
+
+/*******************************************************************************
+=================================== Inserts ====================================
+*******************************************************************************/
+
+// insert
+template<typename T, int Size>
+void LariatIndirect<T, Size>::insert(size_t index, const T & value)
+{
+  if (index > size())
+  {
+    throw LariatException(LariatException::E_BAD_INDEX, "Subscript is out of range");
+  }
+  T *object = construct(value);
+  try
+  {
+    list_.insert(index, object);
+  }
+  catch (...)
+  {
+    destroy(object);
+    throw;
+  }
+}
+
+// push_back
+template<typename T, int Size>
+void LariatIndirect<T, Size>::push_back(const T & value)
+{
+  T *object = construct(value);
+  try
+  {
+    list_.push_back(object);
+  }
+  catch (...)
+  {
+    destroy(object);
+    throw;
+  }
+}
+
+// push_front
+template<typename T, int Size>
+void LariatIndirect<T, Size>::push_front(const T & value)
+{
+  T *object = construct(value);
+  try
+  {
+    list_.push_front(object);
+  }
+  catch (...)
+  {
+    destroy(object);
+    throw;
+  }
+}
+
+/*******************************************************************************
+=================================== Deletes ====================================
+*******************************************************************************/
+
+// erase
+template<typename T, int Size>
+void LariatIndirect<T, Size>::erase(size_t index)
+{
+  // operator[] doesn't check the index, so it is checked before the lookup.
+  if (index >= size())
+  {
+    throw LariatException(LariatException::E_BAD_INDEX, "Subscript is out of range");
+  }
+  T *object = &(*this)[index];
+  list_.erase(index);
+  destroy(object);
+}
+
+// pop_back
+template<typename T, int Size>
+void LariatIndirect<T, Size>::pop_back()
+{
+  T *object = &last();
+  list_.pop_back();
+  destroy(object);
+}
+
+// pop_front
+template<typename T, int Size>
+void LariatIndirect<T, Size>::pop_front()
+{
+  T *object = &first();
+  list_.pop_front();
+  destroy(object);
+}
+
+/*******************************************************************************
+==================================== Access ====================================
+*******************************************************************************/
+
+// The pointers are only read through the const list, so the pointer nodes
+// stay shared and the index is never marked stale; the elements themselves
+// are not in the nodes.
+
+// operator[]
+template<typename T, int Size>
+T & LariatIndirect<T, Size>::operator[](size_t index)
+{
+  return *static_cast<const Lariat<T *, Size> &>(list_)[index];
+}
+
+template<typename T, int Size>
+const T & LariatIndirect<T, Size>::operator[](size_t index) const
+{
+  return *list_[index];
+}
+
+// first
+template<typename T, int Size>
+T & LariatIndirect<T, Size>::first()
+{
+  return *static_cast<const Lariat<T *, Size> &>(list_).first();
+}
+
+template<typename T, int Size>
+T const & LariatIndirect<T, Size>::first() const
+{
+  return *list_.first();
+}
+
+// last
+template<typename T, int Size>
+T & LariatIndirect<T, Size>::last()
+{
+  return *static_cast<const Lariat<T *, Size> &>(list_).last();
+}
+
+template<typename T, int Size>
+T const & LariatIndirect<T, Size>::last() const
+{
+  return *list_.last();
+}
+
+// find
+template<typename T, int Size>
+size_t LariatIndirect<T, Size>::find(const T & value) const
+{
+  size_t index = 0;
+  for (auto segment : list_.segments())
+  {
+    for (T *object : segment)
+    {
+      if (*object == value)
+      {
+        return index;
+      }
+      index++;
+    }
+  }
+  return index;
+}
+
+/*******************************************************************************
+========================== Data Structure Information ==========================
+*******************************************************************************/
+
+// size
+template<typename T, int Size>
+size_t LariatIndirect<T, Size>::size(void) const
+{
+  return list_.size();
+}
+
+// capacity
+template<typename T, int Size>
+size_t LariatIndirect<T, Size>::capacity(void) const
+{
+  return slots_;
+}
+
+// clear
+template<typename T, int Size>
+void LariatIndirect<T, Size>::clear(void)
+{
+  for (auto segment : static_cast<const Lariat<T *, Size> &>(list_).segments())
+  {
+    for (T *object : segment)
+    {
+      object->~T();
+    }
+  }
+  list_.clear();
+  freeChunks();
+}
+
+// compact
+template<typename T, int Size>
+void LariatIndirect<T, Size>::compact()
+{
+  list_.compact();
+}
+
+/*******************************************************************************
+===================================== Slab =====================================
+*******************************************************************************/
+
+// construct
+template<typename T, int Size>
+T * LariatIndirect<T, Size>::construct(const T & value)
+{
+  if (!free_)
+  {
+    SChunk *chunk = new SChunk;
+    chunk->next = chunks_;
+    chunks_ = chunk;
+    slots_ += chunkSlots_;
+    // Thread the new slots onto the free list in address order.
+    for (int i = chunkSlots_ - 1; i >= 0; i--)
+    {
+      chunk->slots[i].next = free_;
+      free_ = &chunk->slots[i];
+    }
+  }
+  SSlot *slot = free_;
+  free_ = slot->next;
+  try
+  {
+    return new (&slot->storage) T(value);
+  }
+  catch (...)
+  {
+    // The failed copy may have scribbled over the link, so relink the slot.
+    slot->next = free_;
+    free_ = slot;
+    throw;
+  }
+}
+
+// destroy
+template<typename T, int Size>
+void LariatIndirect<T, Size>::destroy(T * object)
+{
+  object->~T();
+  SSlot *slot = reinterpret_cast<SSlot *>(object);
+  slot->next = free_;
+  free_ = slot;
+}
+
+// freeChunks
+template<typename T, int Size>
+void LariatIndirect<T, Size>::freeChunks()
+{
+  while (chunks_)
+  {
+    SChunk *next = chunks_->next;
+    delete chunks_;
+    chunks_ = next;
+  }
+  free_ = nullptr;
+  slots_ = 0;
+}
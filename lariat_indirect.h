@@ -0,0 +1,74 @@
+////////////////////////////////////////////////////////////////////////////////
+#ifndef LARIAT_INDIRECT_H
+#define LARIAT_INDIRECT_H
+////////////////////////////////////////////////////////////////////////////////
+
+#include <type_traits> // std::aligned_storage
+#include "lariat.h"
+
+// A Lariat for large element types. The nodes hold pointers to the elements,
+// which live in slots of a separate slab, so shifting, splitting and
+// compacting the nodes only moves pointers. Elements never move once
+// inserted: a reference returned by operator[] stays valid until that element
+// is erased. Erased slots go on a free list and are reused by later inserts.
+template <typename T, int Size>
+class LariatIndirect
+{
+public:
+
+  LariatIndirect();                          // default constructor
+  LariatIndirect(LariatIndirect const& rhs); // copies every element
+  ~LariatIndirect();                         // destructor
+
+  LariatIndirect &operator=(LariatIndirect const& rhs);
+
+  // inserts
+  void insert(size_t index, const T& value);
+  void push_back(const T& value);
+  void push_front(const T& value);
+
+  // deletes
+  void erase(size_t index);
+  void pop_back();
+  void pop_front();
+
+  //access
+  T&       operator[](size_t index);
+  const T& operator[](size_t index) const;
+  T&       first();
+  T const& first() const;
+  T&       last();
+  T const& last() const;
+
+  size_t find(const T& value) const; // returns index, size (one past last) if not found
+
+  size_t size(void) const;
+  size_t capacity(void) const;       // elements the slab holds without allocating
+  void clear(void);                  // destroys the elements and frees the slab
+  void compact();                    // packs the pointer nodes, elements stay put
+
+private:
+  static const int chunkSlots_ = 64;
+
+  union SSlot {
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    SSlot *next;                     // free list link while unused
+  };
+  struct SChunk {
+    SChunk *next;
+    SSlot   slots[chunkSlots_];
+  };
+
+  Lariat<T *, Size> list_;           // element pointers in list order
+  SChunk *chunks_;                   // every chunk allocated so far
+  SSlot  *free_;                     // unused slots
+  size_t  slots_;                    // slots in all chunks
+
+  T   *construct(const T& value);    // copy of value in a free slot
+  void destroy(T *object);           // destructs and frees the slot
+  void freeChunks();
+};
+
+#include "lariat_indirect.cpp"
+
+#endif // LARIAT_INDIRECT_H
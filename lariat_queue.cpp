@@ -0,0 +1,181 @@
+#include "lariat_queue.h"
+
+/*******************************************************************************
+========================= Constructors and Destructor ==========================
+*******************************************************************************/
+
+// Constructor
+template<typename T, int Size>
+LariatQueue<T, Size>::LariatQueue() : head_(nullptr), tail_(), first_(), headCopy_()
+{
+  // The queue always owns at least one node, so neither side ever has to deal
+  // with a null head or tail.
+  QNode *node = makeNode();
+  head_.store(node, std::memory_order_relaxed);
+  tail_ = node;
+  first_ = node;
+  headCopy_ = node;
+}
+
+// Destructor
+template<typename T, int Size>
+LariatQueue<T, Size>::~LariatQueue()
+{
+  // Every node ever allocated is still reachable from first_, both the ones
+  // waiting to be recycled and the ones still holding data.
+  QNode *node = first_;
+  while (node)
+  {
+    QNode *next = node->next.load(std::memory_order_relaxed);
+    delete node;
+    node = next;
+  }
+}
+
+/*******************************************************************************
+================================= Producer =====================================
+*******************************************************************************/
+
+// push
+template<typename T, int Size>
+void LariatQueue<T, Size>::push(const T & value)
+{
+  int write = tail_->write.load(std::memory_order_relaxed);
+  if (write == Size)
+  {
+    appendNode();
+    write = 0;
+  }
+  tail_->values[write] = value;
+  // The release store publishes the value to the consumer.
+  tail_->write.store(write + 1, std::memory_order_release);
+}
+
+// push (batch)
+template<typename T, int Size>
+void LariatQueue<T, Size>::push(const T * values, int count)
+{
+  // Fill the tail node as far as possible and publish the whole run with a
+  // single store, then move on to a fresh node for the rest.
+  while (count > 0)
+  {
+    int write = tail_->write.load(std::memory_order_relaxed);
+    if (write == Size)
+    {
+      appendNode();
+      write = 0;
+    }
+    int run = Size - write < count ? Size - write : count;
+    for (int i = 0; i < run; i++)
+    {
+      tail_->values[write + i] = values[i];
+    }
+    tail_->write.store(write + run, std::memory_order_release);
+    values += run;
+    count -= run;
+  }
+}
+
+/*******************************************************************************
+================================= Consumer =====================================
+*******************************************************************************/
+
+// pop
+template<typename T, int Size>
+bool LariatQueue<T, Size>::pop(T & value)
+{
+  return pop(&value, 1) == 1;
+}
+
+// pop (batch)
+template<typename T, int Size>
+int LariatQueue<T, Size>::pop(T * values, int max)
+{
+  int popped = 0;
+  QNode *node = head_.load(std::memory_order_relaxed);
+  while (popped < max)
+  {
+    int read = node->read.load(std::memory_order_relaxed);
+    int write = node->write.load(std::memory_order_acquire);
+    if (read == write)
+    {
+      // A node is only left behind once the producer has filled it completely
+      // and linked a successor.
+      if (write != Size)
+      {
+        break;
+      }
+      QNode *next = node->next.load(std::memory_order_acquire);
+      if (!next)
+      {
+        break;
+      }
+      // Releasing head_ hands the exhausted node back to the producer.
+      node = next;
+      head_.store(node, std::memory_order_release);
+      continue;
+    }
+    int run = write - read < max - popped ? write - read : max - popped;
+    for (int i = 0; i < run; i++)
+    {
+      values[popped + i] = node->values[read + i];
+    }
+    node->read.store(read + run, std::memory_order_relaxed);
+    popped += run;
+  }
+  return popped;
+}
+
+// empty
+template<typename T, int Size>
+bool LariatQueue<T, Size>::empty() const
+{
+  QNode *node = head_.load(std::memory_order_relaxed);
+  if (node->read.load(std::memory_order_relaxed) != node->write.load(std::memory_order_acquire))
+  {
+    return false;
+  }
+  QNode *next = node->next.load(std::memory_order_acquire);
+  return !next || next->write.load(std::memory_order_acquire) == 0;
+}
+
+/*******************************************************************************
+============================== Helper Functions ================================
+*******************************************************************************/
+
+template<typename T, int Size>
+typename LariatQueue<T, Size>::QNode * LariatQueue<T, Size>::makeNode()
+{
+  QNode *newNode = new QNode();
+  newNode->next.store(nullptr, std::memory_order_relaxed);
+  newNode->read.store(0, std::memory_order_relaxed);
+  newNode->write.store(0, std::memory_order_relaxed);
+
+  return newNode;
+}
+
+template<typename T, int Size>
+void LariatQueue<T, Size>::appendNode()
+{
+  // Nodes in front of the consumer's head are finished with and can be reused
+  // as the new tail. Only re-read head_ when the cached copy has run out.
+  QNode *node = nullptr;
+  if (first_ == headCopy_)
+  {
+    headCopy_ = head_.load(std::memory_order_acquire);
+  }
+  if (first_ != headCopy_)
+  {
+    node = first_;
+    first_ = first_->next.load(std::memory_order_relaxed);
+    node->next.store(nullptr, std::memory_order_relaxed);
+    node->read.store(0, std::memory_order_relaxed);
+    node->write.store(0, std::memory_order_relaxed);
+  }
+  else
+  {
+    node = makeNode();
+  }
+  tail_->next.store(node, std::memory_order_release);
+  tail_ = node;
+}
@@ -0,0 +1,55 @@
+////////////////////////////////////////////////////////////////////////////////
+#ifndef LARIAT_QUEUE_H
+#define LARIAT_QUEUE_H
+////////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>     // per-node indices, published node links
+#include "lariat.h"   // LariatException
+
+// Single-producer/single-consumer FIFO built from the same chain of fixed
+// size arrays as Lariat. Exactly one thread may call the push functions and
+// exactly one (other) thread may call the pop functions; no locks are taken.
+// Emptied head nodes are handed back to the producer and reused as new tails.
+template <typename T, int Size>
+class LariatQueue
+{
+public:
+
+  LariatQueue();   // default constructor
+  ~LariatQueue();  // destructor
+
+  LariatQueue(LariatQueue const& rhs)            = delete;
+  LariatQueue &operator=(LariatQueue const& rhs) = delete;
+
+  // producer side
+  void push(const T& value);
+  void push(const T *values, int count); // batch, one publish per node
+
+  // consumer side
+  bool pop(T& value);                    // false if the queue is empty
+  int  pop(T *values, int max);          // batch, returns number popped
+  bool empty() const;
+
+private:
+  struct QNode {
+    std::atomic<QNode *> next;
+    std::atomic<int>     read;  // next slot the consumer takes
+    std::atomic<int>     write; // one past the last slot the producer filled
+    T values[Size];
+  };
+
+  // consumer owned
+  std::atomic<QNode *> head_;   // node the consumer is reading from
+
+  // producer owned
+  QNode *tail_;                 // node the producer is writing to
+  QNode *first_;                // oldest node not yet recycled
+  QNode *headCopy_;             // last observed value of head_
+
+  QNode *makeNode();
+  void appendNode();
+};
+
+#include "lariat_queue.cpp"
+
+#endif // LARIAT_QUEUE_H
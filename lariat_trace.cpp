@@ -0,0 +1,202 @@
+#include <cstring>      // memcmp
+#include "lariat_trace.h"
+
+// Trace layout:
+//   char[4]   magic "LRTR"
+//   uint32    format version
+//   then one record per operation: uint8 op, followed by
+//     varint index            for insert, erase, index
+//     zigzag varint value     for insert, push_back, push_front, find
+namespace LariatTraceFormat
+{
+  const char     magic[4] = { 'L', 'R', 'T', 'R' };
+  const uint32_t version = 1;
+
+  inline bool hasIndex(LariatTrace::Op op)
+  {
+    return op == LariatTrace::INSERT || op == LariatTrace::ERASE || op == LariatTrace::INDEX;
+  }
+
+  inline bool hasValue(LariatTrace::Op op)
+  {
+    return op == LariatTrace::INSERT || op == LariatTrace::PUSH_BACK ||
+           op == LariatTrace::PUSH_FRONT || op == LariatTrace::FIND;
+  }
+}
+
+/*******************************************************************************
+================================== Recorder ====================================
+*******************************************************************************/
+
+template<typename T, int Size>
+LariatRecorder<T, Size>::LariatRecorder(Lariat<T, Size> & list, std::ostream & trace)
+  : list_(list), trace_(trace)
+{
+  uint32_t version = LariatTraceFormat::version;
+  trace_.write(LariatTraceFormat::magic, sizeof(LariatTraceFormat::magic));
+  trace_.write(reinterpret_cast<const char *>(&version), sizeof(version));
+}
+
+template<typename T, int Size>
+void LariatRecorder<T, Size>::insert(size_t index, const T & value)
+{
+  list_.insert(index, value);
+  record(LariatTrace::INSERT, index, static_cast<int64_t>(value));
+}
+
+template<typename T, int Size>
+void LariatRecorder<T, Size>::push_back(const T & value)
+{
+  list_.push_back(value);
+  record(LariatTrace::PUSH_BACK, 0, static_cast<int64_t>(value));
+}
+
+template<typename T, int Size>
+void LariatRecorder<T, Size>::push_front(const T & value)
+{
+  list_.push_front(value);
+  record(LariatTrace::PUSH_FRONT, 0, static_cast<int64_t>(value));
+}
+
+template<typename T, int Size>
+void LariatRecorder<T, Size>::erase(size_t index)
+{
+  list_.erase(index);
+  record(LariatTrace::ERASE, index, 0);
+}
+
+template<typename T, int Size>
+void LariatRecorder<T, Size>::pop_back()
+{
+  list_.pop_back();
+  record(LariatTrace::POP_BACK, 0, 0);
+}
+
+template<typename T, int Size>
+void LariatRecorder<T, Size>::pop_front()
+{
+  list_.pop_front();
+  record(LariatTrace::POP_FRONT, 0, 0);
+}
+
+template<typename T, int Size>
+const T & LariatRecorder<T, Size>::operator[](size_t index)
+{
+  record(LariatTrace::INDEX, index, 0);
+  return static_cast<const Lariat<T, Size> &>(list_)[index];
+}
+
+template<typename T, int Size>
+size_t LariatRecorder<T, Size>::find(const T & value)
+{
+  record(LariatTrace::FIND, 0, static_cast<int64_t>(value));
+  return list_.find(value);
+}
+
+template<typename T, int Size>
+void LariatRecorder<T, Size>::compact()
+{
+  list_.compact();
+  record(LariatTrace::COMPACT, 0, 0);
+}
+
+template<typename T, int Size>
+Lariat<T, Size> & LariatRecorder<T, Size>::list()
+{
+  return list_;
+}
+
+// record
+// Only operations that succeeded get here, so a replay never throws
+template<typename T, int Size>
+void LariatRecorder<T, Size>::record(LariatTrace::Op op, uint64_t index, int64_t value)
+{
+  char buf[1 + 10 + 10];
+  size_t length = 0;
+  buf[length++] = static_cast<char>(op);
+  if (LariatTraceFormat::hasIndex(op))
+  {
+    for (; index >= 0x80; index >>= 7)
+    {
+      buf[length++] = static_cast<char>((index & 0x7f) | 0x80);
+    }
+    buf[length++] = static_cast<char>(index);
+  }
+  if (LariatTraceFormat::hasValue(op))
+  {
+    // zigzag, so small negative values stay short as well
+    uint64_t zigzag = (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    for (; zigzag >= 0x80; zigzag >>= 7)
+    {
+      buf[length++] = static_cast<char>((zigzag & 0x7f) | 0x80);
+    }
+    buf[length++] = static_cast<char>(zigzag);
+  }
+  trace_.write(buf, static_cast<std::streamsize>(length));
+  if (!trace_)
+  {
+    throw LariatException(LariatException::E_DATA_ERROR, "Failed to write lariat trace");
+  }
+}
+
+/*******************************************************************************
+=================================== Reader =====================================
+*******************************************************************************/
+
+inline LariatTraceReader::LariatTraceReader(std::istream & trace) : trace_(trace)
+{
+  char magic[4] = {};
+  uint32_t version = 0;
+  trace_.read(magic, sizeof(magic));
+  trace_.read(reinterpret_cast<char *>(&version), sizeof(version));
+  if (!trace_ || std::memcmp(magic, LariatTraceFormat::magic, sizeof(magic)) != 0)
+  {
+    throw LariatException(LariatException::E_DATA_ERROR, "Not a lariat trace");
+  }
+  if (version != LariatTraceFormat::version)
+  {
+    throw LariatException(LariatException::E_DATA_ERROR, "Incompatible lariat trace");
+  }
+}
+
+// next
+inline bool LariatTraceReader::next(LariatTraceOp & op)
+{
+  int byte = trace_.get();
+  if (byte == std::char_traits<char>::eof())
+  {
+    return false;
+  }
+  if (byte > LariatTrace::FIND)
+  {
+    throw LariatException(LariatException::E_DATA_ERROR, "Corrupt lariat trace");
+  }
+  op.op = static_cast<LariatTrace::Op>(byte);
+  op.index = LariatTraceFormat::hasIndex(op.op) ? readVarint() : 0;
+  op.value = 0;
+  if (LariatTraceFormat::hasValue(op.op))
+  {
+    uint64_t zigzag = readVarint();
+    op.value = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+  }
+  return true;
+}
+
+inline uint64_t LariatTraceReader::readVarint()
+{
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7)
+  {
+    int byte = trace_.get();
+    if (byte == std::char_traits<char>::eof())
+    {
+      throw LariatException(LariatException::E_DATA_ERROR, "Truncated lariat trace");
+    }
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+    {
+      return value;
+    }
+  }
+  throw LariatException(LariatException::E_DATA_ERROR, "Corrupt lariat trace");
+}
@@ -0,0 +1,87 @@
+////////////////////////////////////////////////////////////////////////////////
+#ifndef LARIAT_TRACE_H
+#define LARIAT_TRACE_H
+////////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>   // trace streams
+#include <cstdint>    // on-disk field widths
+#include <type_traits> // std::is_integral
+#include "lariat.h"
+
+// Operations as they appear in a trace. Values are stored as signed 64 bit
+// integers, so a trace recorded with one integral element type can be
+// replayed with any other numeric one.
+namespace LariatTrace
+{
+  enum Op : uint8_t
+  {
+    INSERT, PUSH_BACK, PUSH_FRONT, COMPACT, ERASE, POP_BACK, POP_FRONT, INDEX, FIND
+  };
+}
+
+struct LariatTraceOp
+{
+  LariatTrace::Op op;
+  uint64_t        index; // insert, erase, index
+  int64_t         value; // insert, push_back, push_front, find
+};
+
+// Forwards every call to a Lariat and appends it to a binary trace. Each
+// record is the op byte followed by its operands as varints (the value
+// zigzag encoded), so most records take two to four bytes.
+template <typename T, int Size>
+class LariatRecorder
+{
+  static_assert(std::is_integral<T>::value,
+                "LariatRecorder stores values as int64_t, T must be integral");
+
+public:
+
+  LariatRecorder(Lariat<T, Size> &list, std::ostream &trace); // writes the trace header
+
+  LariatRecorder(LariatRecorder const& rhs)            = delete;
+  LariatRecorder &operator=(LariatRecorder const& rhs) = delete;
+
+  // inserts
+  void insert(size_t index, const T& value);
+  void push_back(const T& value);
+  void push_front(const T& value);
+
+  // deletes
+  void erase(size_t index);
+  void pop_back();
+  void pop_front();
+
+  // access, recorded as well so a replay does the same lookups
+  const T& operator[](size_t index);
+  size_t   find(const T& value);
+
+  void compact();
+
+  Lariat<T, Size> &list();   // unrecorded access to the wrapped list
+
+private:
+  Lariat<T, Size> &list_;
+  std::ostream    &trace_;
+
+  void record(LariatTrace::Op op, uint64_t index, int64_t value);
+};
+
+// Reads the records of a trace written by LariatRecorder back one at a time.
+class LariatTraceReader
+{
+public:
+
+  explicit LariatTraceReader(std::istream &trace); // checks the trace header
+
+  bool next(LariatTraceOp &op);  // false at the end of the trace
+
+private:
+  std::istream &trace_;
+
+  uint64_t readVarint();
+};
+
+#include "lariat_trace.cpp"
+
+#endif // LARIAT_TRACE_H